@@ -1,4 +1,5 @@
 #include "win32_context.hpp"
+#include "services/async_logger.hpp"
 
 #include <array>
 #include <iostream>
@@ -180,19 +181,19 @@ bool Win32Context::PumpEvents(bstk::OSWindow& _window, iotk::input_t &_state)
             if (::GetCapture() == NULL)
                 ::SetCapture((HWND)_window.hwindow);
 #endif
-            _state.button_down |= iotk::kLeftBtn;
+            iotk::SetButton(iotk::kLeftBtn, true, _state);
         } break;
         case WM_RBUTTONDOWN: case WM_RBUTTONDBLCLK:
         {
             if (::GetCapture() == NULL)
                 ::SetCapture((HWND)_window.hwindow);
-            _state.button_down |= iotk::kRightBtn;
+            iotk::SetButton(iotk::kRightBtn, true, _state);
         } break;
         case WM_MBUTTONDOWN: case WM_MBUTTONDBLCLK:
         {
             if (::GetCapture() == NULL)
                 ::SetCapture((HWND)_window.hwindow);
-            _state.button_down |= iotk::kMiddleBtn;
+            iotk::SetButton(iotk::kMiddleBtn, true, _state);
         } break;
 
         case WM_LBUTTONUP:
@@ -201,19 +202,19 @@ bool Win32Context::PumpEvents(bstk::OSWindow& _window, iotk::input_t &_state)
             if (::GetCapture() == NULL)
                 ::SetCapture((HWND)_window.hwindow);
 #endif
-            _state.button_down &= ~iotk::kLeftBtn;
+            iotk::SetButton(iotk::kLeftBtn, false, _state);
         } break;
         case WM_RBUTTONUP:
         {
             if (::GetCapture() == NULL)
                 ::SetCapture((HWND)_window.hwindow);
-            _state.button_down &= ~iotk::kRightBtn;
+            iotk::SetButton(iotk::kRightBtn, false, _state);
         } break;
         case WM_MBUTTONUP:
         {
             if (::GetCapture() == NULL)
                 ::SetCapture((HWND)_window.hwindow);
-            _state.button_down &= ~iotk::kMiddleBtn;
+            iotk::SetButton(iotk::kMiddleBtn, false, _state);
         } break;
 
         case WM_MOUSEMOVE:
@@ -246,7 +247,7 @@ bool Win32Context::PumpEvents(bstk::OSWindow& _window, iotk::input_t &_state)
                 else
                     key = (std::uint32_t)std::tolower((unsigned char)key);
 
-                _state.key_down[key] = (msg.message == WM_KEYDOWN || msg.message == WM_SYSKEYDOWN);
+                iotk::SetKey(key, (msg.message == WM_KEYDOWN || msg.message == WM_SYSKEYDOWN), _state);
             }
         }
 
@@ -265,7 +266,9 @@ bstk::EngineModule Win32Context::EngineLoad(std::string const& _path, std::strin
         _path,
         _lockfile,
         new Win32ModuleInfo{},
-        bstk::EngineInterface{}
+        bstk::EngineInterface{},
+        "",
+        0
     };
 
     EngineReloadModule(module);
@@ -334,14 +337,14 @@ bstk::PlatformData Win32Context::EngineReloadModule(bstk::EngineModule& _module)
 
     if (!copy_success)
     {
-        std::cout << "Module copy failed" << std::endl;
+        LoaderLog(bstk::kLogError, "Module copy failed");
         return nullptr;
     }
 
     HMODULE module = LoadLibraryA(TEXT(altpath.c_str()));
     if (module == NULL)
     {
-        std::cout << "Module not found" << std::endl;
+        LoaderLog(bstk::kLogError, "Module not found");
         return nullptr;
     }
 
@@ -351,14 +354,20 @@ bstk::PlatformData Win32Context::EngineReloadModule(bstk::EngineModule& _module)
         (bstk::EngineInterface::Reload_t)GetProcAddress(module, "ModuleInterface_Reload"),
         (bstk::EngineInterface::LogicUpdate_t)GetProcAddress(module, "ModuleInterface_LogicUpdate"),
         (bstk::EngineInterface::DrawFrame_t)GetProcAddress(module, "ModuleInterface_DrawFrame"),
+        (bstk::EngineInterface::BindHost_t)GetProcAddress(module, "ModuleInterface_BindHost"),
+        (bstk::EngineInterface::AssetsChanged_t)GetProcAddress(module, "ModuleInterface_AssetsChanged"),
+        (bstk::EngineInterface::WarmUp_t)GetProcAddress(module, "ModuleInterface_WarmUp"),
+        (bstk::EngineInterface::StartTasks_t)GetProcAddress(module, "ModuleInterface_StartTasks"),
     };
 
     if (!interface.Create)
-        std::cout << "Create not found" << std::endl;
+        LoaderLog(bstk::kLogWarning, "Create not found");
 
     _module.interface = interface;
     moduleInfo.timestamp = lastWriteTime;
     moduleInfo.handle = module;
+    _module.loaded_path = altpath;
+    ++_module.generation;
     return stale_module.release();
 }
 
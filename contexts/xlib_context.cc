@@ -17,6 +17,8 @@
 
 #include <iostream>
 
+#include "services/async_logger.hpp"
+
 namespace bstk {
 
 std::unique_ptr<OSContext> CreateContext() { return std::unique_ptr<OSContext>(new XlibContext()); }
@@ -53,6 +55,16 @@ static time_t PosixLastWriteTime(char const* _path)
     return file_stat.st_mtime;
 }
 
+// True while the dynamic loader still maps _path, e.g. a generation kept for hot patching.
+static bool PosixLibraryLoaded(std::string const& _path)
+{
+    void* handle = dlopen(_path.c_str(), RTLD_NOW | RTLD_NOLOAD);
+    if (!handle)
+        return false;
+    dlclose(handle);
+    return true;
+}
+
 static void PosixCopyFile(char const* _src, char const* _dst)
 {
     int dest_file = open(_dst,
@@ -176,11 +188,11 @@ bool XlibContext::PumpEvents(bstk::OSWindow& _window, iotk::input_t& _state)
             XButtonEvent& xbevent = xevent.xbutton;
 
             if (xbevent.button == Button1)
-                _state.button_down |= iotk::kLeftBtn;
+                iotk::SetButton(iotk::kLeftBtn, true, _state);
             if (xbevent.button == Button2)
-                _state.button_down |= iotk::kMiddleBtn;
+                iotk::SetButton(iotk::kMiddleBtn, true, _state);
             if (xbevent.button == Button3)
-                _state.button_down |= iotk::kRightBtn;
+                iotk::SetButton(iotk::kRightBtn, true, _state);
 
             if (xbevent.button == Button4)
                 _state.wheel_delta = 140;
@@ -194,11 +206,11 @@ bool XlibContext::PumpEvents(bstk::OSWindow& _window, iotk::input_t& _state)
             XButtonEvent& xbevent = xevent.xbutton;
 
             if (xbevent.button == Button1)
-                _state.button_down &= ~iotk::kLeftBtn;
+                iotk::SetButton(iotk::kLeftBtn, false, _state);
             if (xbevent.button == Button2)
-                _state.button_down &= ~iotk::kMiddleBtn;
+                iotk::SetButton(iotk::kMiddleBtn, false, _state);
             if (xbevent.button == Button3)
-                _state.button_down &= ~iotk::kRightBtn;
+                iotk::SetButton(iotk::kRightBtn, false, _state);
 
             //std::cout << "button up" << std::endl;
         } break;
@@ -252,7 +264,7 @@ bool XlibContext::PumpEvents(bstk::OSWindow& _window, iotk::input_t& _state)
             else
                 key = (std::uint32_t)std::tolower((unsigned char)key);
 
-            _state.key_down[key] = (xevent.type == KeyPress);
+            iotk::SetKey(key, (xevent.type == KeyPress), _state);
         } break;
 
         case MotionNotify:
@@ -297,8 +309,14 @@ bstk::EngineModule XlibContext::EngineLoad(std::string const& _path, std::string
             bstk::StubEngine::Shutdown,
             bstk::StubEngine::Reload,
             bstk::StubEngine::LogicUpdate,
-            bstk::StubEngine::DrawFrame
-        }
+            bstk::StubEngine::DrawFrame,
+            bstk::StubEngine::BindHost,
+            bstk::StubEngine::AssetsChanged,
+            bstk::StubEngine::WarmUp,
+            bstk::StubEngine::StartTasks
+        },
+        "",
+        0
     };
 
     EngineReloadModule(module);
@@ -333,24 +351,40 @@ bstk::PlatformData XlibContext::EngineReloadModule(bstk::EngineModule& _module)
 
     std::unique_ptr<XlibModuleInfo> stale_module{ new XlibModuleInfo(moduleInfo) };
 
-    std::string altpath = _module.path;
-    altpath[altpath.size() - 1] = '_';
-    altpath += std::to_string(moduleInfo.load_index);
+    // The index wraps, copies still mapped (hot patching keeps every generation) are skipped
+    // rather than overwritten under the running code.
+    constexpr uint32_t kCopyCount = 0x100;
+    std::string altpath = "";
+    uint32_t copy_index = moduleInfo.load_index;
+    for (uint32_t probe = 0; probe < kCopyCount; ++probe, copy_index = (copy_index + 1) & 0xff)
+    {
+        std::string candidate = _module.path;
+        candidate[candidate.size() - 1] = '_';
+        candidate += std::to_string(copy_index);
+        if (!PosixLibraryLoaded(candidate))
+        {
+            altpath = candidate;
+            break;
+        }
+    }
+    if (altpath.empty())
+    {
+        LoaderLog(bstk::kLogError, "all {} module copies are still loaded, reload refused", kCopyCount);
+        return nullptr;
+    }
 
     time_t lastWriteTime = PosixLastWriteTime(_module.path.c_str());
 
-    std::cout << "copying to " << altpath << std::endl;
+    LoaderLog(bstk::kLogInfo, "copying to {}", altpath.c_str());
     PosixCopyFile(_module.path.c_str(), altpath.c_str());
 
     void* hlib = dlopen(altpath.c_str(), RTLD_NOW);
     if (!hlib)
     {
-        std::cout << "hlib not found "
-                  << dlerror()
-                  << std::endl;
+        LoaderLog(bstk::kLogError, "hlib not found {}", dlerror());
         return nullptr;
     }
-    moduleInfo.load_index = (moduleInfo.load_index+1) & 0xff;
+    moduleInfo.load_index = (copy_index + 1) & 0xff;
 
     bstk::EngineInterface interface{
         (bstk::EngineInterface::Create_t)dlsym(hlib, "ModuleInterface_Create"),
@@ -358,6 +392,10 @@ bstk::PlatformData XlibContext::EngineReloadModule(bstk::EngineModule& _module)
         (bstk::EngineInterface::Reload_t)dlsym(hlib, "ModuleInterface_Reload"),
         (bstk::EngineInterface::LogicUpdate_t)dlsym(hlib, "ModuleInterface_LogicUpdate"),
         (bstk::EngineInterface::DrawFrame_t)dlsym(hlib, "ModuleInterface_DrawFrame"),
+        (bstk::EngineInterface::BindHost_t)dlsym(hlib, "ModuleInterface_BindHost"),
+        (bstk::EngineInterface::AssetsChanged_t)dlsym(hlib, "ModuleInterface_AssetsChanged"),
+        (bstk::EngineInterface::WarmUp_t)dlsym(hlib, "ModuleInterface_WarmUp"),
+        (bstk::EngineInterface::StartTasks_t)dlsym(hlib, "ModuleInterface_StartTasks"),
     };
 
 #if 0
@@ -371,12 +409,14 @@ bstk::PlatformData XlibContext::EngineReloadModule(bstk::EngineModule& _module)
 #endif
 
     if (!interface.Create)
-        std::cout << "Create not found" << std::endl;
+        LoaderLog(bstk::kLogWarning, "Create not found");
 
     _module.interface = interface;
     moduleInfo.timestamp = lastWriteTime;
     moduleInfo.hlib = hlib;
-    std::cout << "reload successful" << std::endl;
+    _module.loaded_path = altpath;
+    ++_module.generation;
+    LoaderLog(bstk::kLogInfo, "reload successful");
     return stale_module.release();
 }
 
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <type_traits>
 
 #include "iotk.hpp"
 
@@ -20,6 +21,160 @@ struct OSWindow
     void* platform_data;
 };
 
+enum eFileStatus : uint32_t
+{
+    kFileIdle = 0u,
+    kFilePending,
+    kFileDone,
+    kFileFailed
+};
+
+// Owned by the engine, must stay alive until it is done or released.
+struct FileRequest
+{
+    char const* path;
+    void* buffer; // nullptr reads into a host-owned buffer, see HostServices::ReleaseFile
+    uint64_t offset;
+    uint64_t size; // 0 reads until the end of the file, host-owned buffers only
+
+    uint32_t status;
+    int32_t error;
+    void const* data;
+    uint64_t bytes_read;
+};
+
+// Read-only view into a loader-mapped asset pack.
+struct AssetView
+{
+    void const* data;
+    uint64_t size;
+};
+
+enum eLogLevel : uint32_t
+{
+    kLogInfo = 0u,
+    kLogWarning,
+    kLogError
+};
+
+enum eLogArgType : uint32_t
+{
+    kLogArgNone = 0u,
+    kLogArgSigned,
+    kLogArgUnsigned,
+    kLogArgDouble,
+    kLogArgString,
+    kLogArgPointer
+};
+
+// Log arguments are stored as is (strings are copied) and formatted on the logger thread.
+struct LogArg
+{
+    LogArg() : type{ kLogArgNone }, unsigned_value{ 0 } {}
+
+    template <typename T>
+    LogArg(T const& _value)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            type = kLogArgDouble;
+            double_value = (double)_value;
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        {
+            type = kLogArgSigned;
+            signed_value = (int64_t)_value;
+        }
+        else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+        {
+            type = kLogArgUnsigned;
+            unsigned_value = (uint64_t)_value;
+        }
+        else if constexpr (std::is_convertible_v<T const&, char const*>)
+        {
+            type = kLogArgString;
+            string_value = _value;
+        }
+        else
+        {
+            static_assert(std::is_pointer_v<T>, "unsupported log argument");
+            type = kLogArgPointer;
+            pointer_value = (void const*)_value;
+        }
+    }
+
+    eLogArgType type;
+    union
+    {
+        int64_t signed_value;
+        uint64_t unsigned_value;
+        double double_value;
+        char const* string_value;
+        void const* pointer_value;
+    };
+};
+
+// Points of the frame where the loader resumes engine tasks.
+enum eTaskPhase : uint32_t
+{
+    kTaskPhaseFrameBegin = 0u,  // before LogicUpdate
+    kTaskPhaseAfterLogic,       // between LogicUpdate and DrawFrame
+    kTaskPhaseFrameEnd,         // after DrawFrame
+    kTaskPhaseCount
+};
+
+// Loader-owned services, they outlive module reloads.
+// Modules receive it through ModuleInterface_BindHost each time they are loaded.
+struct HostServices
+{
+    uint32_t size;
+
+    void* file_service;
+    bool (*ReadFile)(void* _service, FileRequest* _request);
+    // Cancels a pending request or hands a host-owned buffer back.
+    void (*ReleaseFile)(void* _service, FileRequest* _request);
+
+    // Recursively watches a directory, changes are batched into EngineInterface::AssetsChanged.
+    void* asset_watcher;
+    bool (*WatchAssets)(void* _watcher, char const* _directory);
+
+    // Looks a path up in the packs passed to the loader, data stays valid until shutdown.
+    void* asset_packs;
+    bool (*FindAsset)(void* _packs, char const* _path, AssetView* _view);
+
+    // Per-thread linear memory, reclaimed by the loader once the frame is no longer in flight.
+    void* scratch_allocator;
+    void* (*ScratchAlloc)(void* _allocator, uint64_t _size, uint64_t _alignment);
+
+    // Engine worker threads call it once when they start to follow the loader's worker
+    // scheduling policy (CPU affinity, priority).
+    void* thread_tuning;
+    void (*ConfigureWorkerThread)(void* _tuning);
+
+    // Never blocks, messages are dropped when the logger falls behind. Arguments replace
+    // "{}" in order. _format must stay valid until the module is unloaded.
+    void* logger;
+    void (*Log)(void* _logger, eLogLevel _level, char const* _format, LogArg const* _args, uint32_t _arg_count);
+
+    // Coroutine scheduling on the frame thread, handles are std::coroutine_handle<> addresses.
+    // See bstk_task.hpp for the engine side. Tasks don't survive reloads.
+    void* task_scheduler;
+    // The scheduler owns the task from then on, it starts at the next kTaskPhaseFrameBegin.
+    void (*SpawnTask)(void* _scheduler, void* _handle);
+    void (*ResumeAtPhase)(void* _scheduler, void* _handle, eTaskPhase _phase);
+    // Resumed at the first phase after the request left kFilePending.
+    void (*ResumeOnFile)(void* _scheduler, void* _handle, FileRequest* _request);
+    // _job runs on a worker thread, the task is resumed at the first phase after it returned.
+    void (*ResumeAfterJob)(void* _scheduler, void* _handle, void (*_job)(void*), void* _data);
+};
+
+template <typename... Args>
+inline void Log(HostServices const* _host, eLogLevel _level, char const* _format, Args const&... _args)
+{
+    LogArg const args[] = { LogArg(_args)..., LogArg() };
+    _host->Log(_host->logger, _level, _format, args, (uint32_t)sizeof...(Args));
+}
+
 struct EngineInterface
 {
     using context_t = void;
@@ -29,12 +184,22 @@ struct EngineInterface
     using Reload_t = void (*)(context_t*);
     using LogicUpdate_t = bool (*)(context_t*, iotk::input_t const*);
     using DrawFrame_t = void (*)(context_t*, bstk::OSWindow const*);
+    using BindHost_t = void (*)(HostServices const*);
+    using AssetsChanged_t = void (*)(context_t*, char const* const*, uint32_t);
+    // Called after Reload, before the first frame of a new generation.
+    using WarmUp_t = void (*)(context_t*);
+    // Called after Create and after every Reload to spawn the engine's tasks.
+    using StartTasks_t = void (*)(context_t*);
 
     Create_t Create;
     Shutdown_t Shutdown;
     Reload_t Reload;
     LogicUpdate_t LogicUpdate;
     DrawFrame_t DrawFrame;
+    BindHost_t BindHost;
+    AssetsChanged_t AssetsChanged;
+    WarmUp_t WarmUp;
+    StartTasks_t StartTasks;
 };
 
 using PlatformData = void*;
@@ -45,6 +210,10 @@ struct EngineModule
     std::string lockfile;
     PlatformData platform_data;
     EngineInterface interface;
+
+    // Copy of path the current code was loaded from, and how many times it was (re)loaded.
+    std::string loaded_path;
+    uint32_t generation;
 };
 
 struct OSContext
@@ -71,6 +240,10 @@ inline void Shutdown(void*) {}
 inline void Reload(void*) {}
 inline bool LogicUpdate(void*, iotk::input_t const*) { return true; }
 inline void DrawFrame(void*, OSWindow const*) {}
+inline void BindHost(HostServices const*) {}
+inline void AssetsChanged(void*, char const* const*, uint32_t) {}
+inline void WarmUp(void*) {}
+inline void StartTasks(void*) {}
 }
 
 struct StubOS : public OSContext
@@ -88,8 +261,14 @@ struct StubOS : public OSContext
                 StubEngine::Shutdown,
                 StubEngine::Reload,
                 StubEngine::LogicUpdate,
-                StubEngine::DrawFrame
-            }
+                StubEngine::DrawFrame,
+                StubEngine::BindHost,
+                StubEngine::AssetsChanged,
+                StubEngine::WarmUp,
+                StubEngine::StartTasks
+            },
+            "",
+            0
         };
     }
     void EngineRelease(EngineModule&) override {}
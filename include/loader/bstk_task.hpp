@@ -0,0 +1,113 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+#include "bstk.hpp"
+
+namespace bstk
+{
+
+// Engine side of the loader's task scheduler (HostServices::task_scheduler), C++20 only.
+// Tasks run on the frame thread and suspend on a frame phase, a file read or a job running on a
+// loader worker thread. They are destroyed before a reload, StartTasks spawns them again.
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() { return Task{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        // Started by the scheduler, which also destroys the frame once it completed.
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// False when the host doesn't schedule tasks (batch runs), the task is destroyed unstarted.
+inline bool Spawn(HostServices const* _host, Task _task)
+{
+    if (!_host->SpawnTask)
+    {
+        _task.handle.destroy();
+        return false;
+    }
+    _host->SpawnTask(_host->task_scheduler, _task.handle.address());
+    return true;
+}
+
+struct PhaseAwaiter
+{
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> _handle) const
+    {
+        host->ResumeAtPhase(host->task_scheduler, _handle.address(), phase);
+    }
+    void await_resume() const noexcept {}
+
+    HostServices const* host;
+    eTaskPhase phase;
+};
+
+// Resumes at _phase of the next frame, or later in the current one when it hasn't been reached yet.
+inline PhaseAwaiter NextPhase(HostServices const* _host, eTaskPhase _phase)
+{
+    return PhaseAwaiter{ _host, _phase };
+}
+
+inline PhaseAwaiter NextFrame(HostServices const* _host)
+{
+    return PhaseAwaiter{ _host, kTaskPhaseFrameBegin };
+}
+
+// Submits the read, true once it is kFileDone. The request must outlive the co_await.
+struct FileAwaiter
+{
+    bool await_ready()
+    {
+        if (!host->ReadFile(host->file_service, request))
+            return true;
+        return request->status != kFilePending;
+    }
+    void await_suspend(std::coroutine_handle<> _handle) const
+    {
+        host->ResumeOnFile(host->task_scheduler, _handle.address(), request);
+    }
+    bool await_resume() const noexcept { return request->status == kFileDone; }
+
+    HostServices const* host;
+    FileRequest* request;
+};
+
+inline FileAwaiter ReadFile(HostServices const* _host, FileRequest* _request)
+{
+    return FileAwaiter{ _host, _request };
+}
+
+// Runs _job() on a loader worker thread, the task resumes on the frame thread afterwards.
+template <typename Job>
+struct JobAwaiter
+{
+    static void Invoke(void* _job) { (*(Job*)_job)(); }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> _handle)
+    {
+        host->ResumeAfterJob(host->task_scheduler, _handle.address(), &JobAwaiter::Invoke, &job);
+    }
+    void await_resume() const noexcept {}
+
+    HostServices const* host;
+    Job job;
+};
+
+template <typename Job>
+inline JobAwaiter<Job> RunJob(HostServices const* _host, Job _job)
+{
+    return JobAwaiter<Job>{ _host, std::move(_job) };
+}
+
+} // namespace bstk
@@ -44,17 +44,110 @@ enum fMouseButton
     kRightBtn = 1u << 2
 };
 
+constexpr uint32_t kKeyWordCount = 256u / 64u;
+
+// Key state is stored as 256-bit sets. Pressed/released masks accumulate every
+// edge seen since the last ClearEdges, so a press and release within the same
+// frame are both reported.
 struct input_t
 {
     float time_delta;
 
-    bool key_down[256];
     uint32_t mod_down;
     int32_t cursor[2];
     int32_t wheel_delta;
     uint32_t button_down;
+    uint32_t button_pressed;
+    uint32_t button_released;
+
+    alignas(32) uint64_t key_down[kKeyWordCount];
+    uint64_t key_pressed[kKeyWordCount];
+    uint64_t key_released[kKeyWordCount];
 };
 
+static inline bool KeyBit(uint64_t const (&bits_)[kKeyWordCount], uint32_t key_)
+{
+    return ((bits_[(key_ >> 6) & (kKeyWordCount - 1)] >> (key_ & 63u)) & 1u) != 0;
+}
+
+static inline bool KeyDown(uint32_t key_, input_t const& input_)
+{
+    return KeyBit(input_.key_down, key_);
+}
+
+static inline bool KeyPress(uint32_t key_, input_t const& input_)
+{
+    return KeyBit(input_.key_pressed, key_);
+}
+
+static inline bool KeyRelease(uint32_t key_, input_t const& input_)
+{
+    return KeyBit(input_.key_released, key_);
+}
+
+static inline bool AnyKeyPress(input_t const& input_)
+{
+    uint64_t any = 0u;
+    for (uint32_t word = 0; word < kKeyWordCount; ++word)
+        any |= input_.key_pressed[word];
+    return any != 0u;
+}
+
+// Platform side, records a key transition and its edge.
+static inline void SetKey(uint32_t key_, bool down_, input_t& input_)
+{
+    uint32_t const word = (key_ >> 6) & (kKeyWordCount - 1);
+    uint64_t const bit = uint64_t(1) << (key_ & 63u);
+
+    if (down_)
+    {
+        input_.key_pressed[word] |= bit & ~input_.key_down[word];
+        input_.key_down[word] |= bit;
+    }
+    else
+    {
+        input_.key_released[word] |= bit & input_.key_down[word];
+        input_.key_down[word] &= ~bit;
+    }
+}
+
+// Platform side, records a mouse button transition and its edge.
+static inline void SetButton(fMouseButton button_, bool down_, input_t& input_)
+{
+    if (down_)
+    {
+        input_.button_pressed |= button_ & ~input_.button_down;
+        input_.button_down |= button_;
+    }
+    else
+    {
+        input_.button_released |= button_ & input_.button_down;
+        input_.button_down &= ~(uint32_t)button_;
+    }
+}
+
+// Called by the loader once the frame has consumed the input.
+static inline void ClearEdges(input_t& input_)
+{
+    for (uint32_t word = 0; word < kKeyWordCount; ++word)
+    {
+        input_.key_pressed[word] = 0u;
+        input_.key_released[word] = 0u;
+    }
+    input_.button_pressed = 0u;
+    input_.button_released = 0u;
+}
+
+static inline bool MouseRelease(fMouseButton button_, input_t const& input_)
+{
+    return (input_.button_released & button_) != 0;
+}
+
+static inline bool MousePress(fMouseButton button_, input_t const& input_)
+{
+    return (input_.button_pressed & button_) != 0;
+}
+
 static inline bool MouseRelease(fMouseButton button_, input_t const& input_, input_t const& past_input_)
 {
     return ((input_.button_down & button_) == 0) && ((past_input_.button_down & button_) != 0);
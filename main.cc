@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <memory>
@@ -5,54 +6,606 @@
 #include "loader/iotk.hpp"
 #include "loader/bstk.hpp"
 
+#include "services/asset_pack.hpp"
+#include "services/async_logger.hpp"
+#include "services/asset_watcher.hpp"
+#include "services/batch_runner.hpp"
+#include "services/build_driver.hpp"
+#include "services/control_server.hpp"
+#include "services/file_service.hpp"
+#include "services/frame_stats.hpp"
+#include "services/hot_patcher.hpp"
+#include "services/module_memory.hpp"
+#include "services/module_prefaulter.hpp"
+#include "services/sampling_profiler.hpp"
+#include "services/scratch_allocator.hpp"
+#include "services/task_scheduler.hpp"
+#include "services/thread_tuning.hpp"
+
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <chrono>
 using StdClock = std::chrono::high_resolution_clock;
 
+struct LoaderOptions
+{
+    char const* module_path = nullptr;
+    char const* lockfile = "build.lock";
+
+    uint64_t hitch_threshold_us = 33000;
+    uint32_t asset_debounce_ms = 100;
+    std::string stats_csv = "";
+
+    uint32_t batch_instances = 0;
+    uint32_t batch_frames = 1000;
+    uint32_t batch_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    float batch_time_step = 1.f / 60.f;
+
+    std::string profile_output = "";
+    uint32_t profile_frequency = 997;
+    std::vector<std::string> packs = {};
+
+    uint64_t scratch_size = 4u << 20;
+    uint32_t frames_in_flight = 1;
+
+    std::vector<std::string> source_directories = {};
+    std::string build_command = "";
+
+    std::string control_socket = "";
+    uint32_t fps_cap = 0;
+
+    bool hot_patch = false;
+    bool prefault = true;
+
+    ThreadTuningOptions thread_tuning = {};
+
+    uint32_t log_slots = 4096;
+    uint32_t task_workers = 2;
+};
+
+// Comma separated CPU indices or ranges, e.g. 0,2-3.
+static std::vector<uint32_t> ParseCpuList(std::string const& _value)
+{
+    std::vector<uint32_t> cpus{};
+    std::istringstream list(_value);
+    std::string item;
+    while (std::getline(list, item, ','))
+    {
+        std::size_t const dash = item.find('-');
+        uint32_t const first = (uint32_t)std::stoul(item.substr(0, dash));
+        uint32_t const last = (dash != std::string::npos) ? (uint32_t)std::stoul(item.substr(dash + 1)) : first;
+        for (uint32_t cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// Positional arguments are <module> [lockfile], everything else is --name=value.
+static LoaderOptions ParseOptions(int argc, char const** argv)
+{
+    LoaderOptions options{};
+    uint32_t positional_index = 0;
+
+    for (int arg_index = 1; arg_index < argc; ++arg_index)
+    {
+        std::string const arg = argv[arg_index];
+        if (arg.rfind("--", 0) != 0)
+        {
+            if (positional_index == 0)
+                options.module_path = argv[arg_index];
+            else if (positional_index == 1)
+                options.lockfile = argv[arg_index];
+            ++positional_index;
+            continue;
+        }
+
+        std::size_t const separator = arg.find('=');
+        std::string const name = arg.substr(2, separator - 2);
+        std::string const value = (separator != std::string::npos) ? arg.substr(separator + 1) : "";
+
+        if (name == "hitch-ms")
+            options.hitch_threshold_us = (uint64_t)(std::stod(value) * 1000.0);
+        else if (name == "asset-debounce-ms")
+            options.asset_debounce_ms = (uint32_t)std::stoul(value);
+        else if (name == "pack")
+            options.packs.push_back(value);
+        else if (name == "watch-source")
+            options.source_directories.push_back(value);
+        else if (name == "build-command")
+            options.build_command = value;
+        else if (name == "scratch-kb")
+            options.scratch_size = (uint64_t)std::stoull(value) << 10;
+        else if (name == "frames-in-flight")
+            options.frames_in_flight = (uint32_t)std::stoul(value);
+        else if (name == "profile")
+            options.profile_output = value;
+        else if (name == "profile-hz")
+            options.profile_frequency = (uint32_t)std::stoul(value);
+        else if (name == "batch")
+            options.batch_instances = (uint32_t)std::stoul(value);
+        else if (name == "batch-frames")
+            options.batch_frames = (uint32_t)std::stoul(value);
+        else if (name == "batch-threads")
+            options.batch_threads = (uint32_t)std::stoul(value);
+        else if (name == "batch-dt")
+            options.batch_time_step = std::stof(value);
+        else if (name == "stats-csv")
+            options.stats_csv = value;
+        else if (name == "control-socket")
+            options.control_socket = value;
+        else if (name == "fps-cap")
+            options.fps_cap = (uint32_t)std::stoul(value);
+        else if (name == "hot-patch")
+            options.hot_patch = true;
+        else if (name == "no-prefault")
+            options.prefault = false;
+        else if (name == "frame-cpus")
+            options.thread_tuning.frame_policy.cpus = ParseCpuList(value);
+        else if (name == "worker-cpus")
+            options.thread_tuning.worker_policy.cpus = ParseCpuList(value);
+        else if (name == "frame-priority")
+            options.thread_tuning.frame_policy.priority = (int32_t)std::stol(value);
+        else if (name == "worker-priority")
+            options.thread_tuning.worker_policy.priority = (int32_t)std::stol(value);
+        else if (name == "fifo")
+            options.thread_tuning.fifo = true;
+        else if (name == "mlock")
+            options.thread_tuning.lock_memory = true;
+        else if (name == "tuning-baseline")
+            options.thread_tuning.baseline_frames = (uint32_t)std::stoul(value);
+        else if (name == "log-slots")
+            options.log_slots = (uint32_t)std::stoul(value);
+        else if (name == "task-workers")
+            options.task_workers = (uint32_t)std::stoul(value);
+        else
+            std::cout << "[WARNING] unknown option " << arg << std::endl;
+    }
+
+    return options;
+}
+
+static uint64_t ElapsedMicroseconds(StdClock::time_point _begin, StdClock::time_point _end)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(_end - _begin).count();
+}
+
+// Frame loop state driven by the control channel.
+struct FrameControl
+{
+    bool paused = false;
+    uint32_t pending_steps = 0;
+    float step_time_step = 1.f / 60.f;
+    uint64_t step_client = 0;
+
+    bool reload_requested = false;
+    uint64_t reload_client = 0;
+
+    uint32_t fps_cap = 0;
+};
+
+// Control input comes from outside the process, malformed numbers must not throw.
+static bool ParseUnsigned(std::string const& _text, uint32_t& _value)
+{
+    char* end = nullptr;
+    unsigned long const value = std::strtoul(_text.c_str(), &end, 10);
+    if (_text.empty() || *end != '\0' || value > UINT32_MAX)
+        return false;
+    _value = (uint32_t)value;
+    return true;
+}
+
+static bool ParsePositive(std::string const& _text, float& _value)
+{
+    char* end = nullptr;
+    float const value = std::strtof(_text.c_str(), &end);
+    if (_text.empty() || *end != '\0' || !(value > 0.f))
+        return false;
+    _value = value;
+    return true;
+}
+
+static void HandleControlCommands(ControlServer& _server, FrameControl& _control,
+                                  FrameStats const& _frame_stats, SamplingProfiler* _profiler)
+{
+    for (ControlServer::Command const& command : _server.Poll())
+    {
+        std::string const& verb = command.words[0];
+        std::size_t const argument_count = command.words.size() - 1;
+
+        if (verb == "reload")
+        {
+            // Answered once the reload was attempted.
+            _control.reload_requested = true;
+            if (_control.reload_client)
+                _server.Error(_control.reload_client, "superseded");
+            _control.reload_client = command.client;
+        }
+        else if (verb == "pause")
+        {
+            _control.paused = true;
+            _server.Ok(command.client);
+        }
+        else if (verb == "resume")
+        {
+            _control.paused = false;
+            _control.pending_steps = 0;
+            if (_control.step_client)
+                _server.Error(_control.step_client, "resumed");
+            _control.step_client = 0;
+            _server.Ok(command.client);
+        }
+        else if (verb == "step")
+        {
+            // step [count [time_step]], pauses and answers once the frames were run.
+            uint32_t count = 1;
+            float time_step = _control.step_time_step;
+            if ((argument_count > 0 && (!ParseUnsigned(command.words[1], count) || count == 0))
+                || (argument_count > 1 && !ParsePositive(command.words[2], time_step)))
+                _server.Error(command.client, "usage: step [count [time_step]]");
+            else if (_control.step_client)
+                _server.Error(command.client, "step in progress");
+            else
+            {
+                _control.paused = true;
+                _control.pending_steps = count;
+                _control.step_time_step = time_step;
+                _control.step_client = command.client;
+            }
+        }
+        else if (verb == "fps")
+        {
+            // fps 0 removes the cap.
+            uint32_t cap = 0;
+            if (argument_count != 1 || !ParseUnsigned(command.words[1], cap))
+                _server.Error(command.client, "usage: fps <cap>");
+            else
+            {
+                _control.fps_cap = cap;
+                _server.Ok(command.client);
+            }
+        }
+        else if (verb == "profile")
+        {
+            if (argument_count != 1)
+                _server.Error(command.client, "usage: profile <path>");
+            else if (!_profiler)
+                _server.Error(command.client, "profiler disabled, start with --profile");
+            else if (!_profiler->WriteFolded(command.words[1]))
+                _server.Error(command.client, "couldn't write " + command.words[1]);
+            else
+                _server.Ok(command.client);
+        }
+        else if (verb == "stats")
+        {
+            std::ostringstream report;
+            _frame_stats.WriteReport(report);
+            _server.Write(command.client, report.str());
+            _server.Ok(command.client);
+        }
+        else
+        {
+            _server.Error(command.client,
+                          "unknown command, expected reload|pause|resume|step|fps|profile|stats");
+        }
+    }
+}
+
 int main(int argc, char const** argv)
 {
+    LoaderOptions const options = ParseOptions(argc, argv);
+    if (!options.module_path)
+    {
+        std::cout << "usage: " << argv[0] << " <module> [lockfile]" << std::endl
+                  << "\t--hitch-ms=N --stats-csv=path" << std::endl
+                  << "\t--asset-debounce-ms=N --pack=path..." << std::endl
+                  << "\t--watch-source=dir... --build-command=cmd" << std::endl
+                  << "\t--scratch-kb=N --frames-in-flight=N" << std::endl
+                  << "\t--profile=path.folded --profile-hz=N" << std::endl
+                  << "\t--control-socket=path --fps-cap=N" << std::endl
+                  << "\t--hot-patch --no-prefault" << std::endl
+                  << "\t--frame-cpus=list --worker-cpus=list --frame-priority=N --worker-priority=N" << std::endl
+                  << "\t--fifo --mlock --tuning-baseline=frames" << std::endl
+                  << "\t--log-slots=N --task-workers=N" << std::endl
+                  << "\t--batch=N --batch-frames=N --batch-threads=N --batch-dt=seconds" << std::endl;
+        return 1;
+    }
+
+    // Outlives everything that may log.
+    AsyncLogger logger{ options.log_slots };
+    InstallLoaderLogger(&logger);
+
     std::unique_ptr<bstk::OSContext> oscontext = bstk::CreateContext();
 
+    std::unique_ptr<FileService> file_service = CreateFileService();
+
+    bstk::HostServices host{};
+    host.size = sizeof(bstk::HostServices);
+    BindFileService(host, file_service.get());
+    BindAsyncLogger(host, &logger);
+
+    std::unique_ptr<AssetWatcher> asset_watcher = CreateAssetWatcher();
+    asset_watcher->debounce = std::chrono::milliseconds(options.asset_debounce_ms);
+    BindAssetWatcher(host, asset_watcher.get());
+
+    AssetPacks asset_packs{};
+    for (std::string const& pack_path : options.packs)
+        asset_packs.Open(pack_path);
+    BindAssetPacks(host, &asset_packs);
+
+    ScratchAllocator scratch_allocator{ options.scratch_size, options.frames_in_flight };
+    BindScratchAllocator(host, &scratch_allocator);
+
+    std::unique_ptr<ThreadTuning> thread_tuning = CreateThreadTuning(options.thread_tuning);
+    BindThreadTuning(host, thread_tuning.get());
+
+    std::unique_ptr<BuildDriver> build_driver = nullptr;
+    if (!options.build_command.empty() && !options.source_directories.empty())
+    {
+        build_driver = CreateBuildDriver(options.build_command, options.source_directories);
+        if (!build_driver)
+            std::cout << "[WARNING] loader-driven builds unavailable" << std::endl;
+        else
+            build_driver->thread_tuning = thread_tuning.get();
+    }
+
+    if (options.batch_instances > 0)
+    {
+        bstk::EngineModule module = oscontext->EngineLoad(options.module_path, options.lockfile);
+        BatchOptions const batch_options{
+            options.batch_instances,
+            options.batch_frames,
+            options.batch_threads,
+            options.batch_time_step,
+            { 1280, 720 }
+        };
+        // No real time to compare against, policies apply right away.
+        thread_tuning->Activate();
+        logger.Flush();
+        RunBatch(module.interface, host, *file_service, scratch_allocator, batch_options);
+        scratch_allocator.PrintReport();
+        oscontext->EngineRelease(module);
+        return 0;
+    }
+
+    // Tasks are only driven by the frame loop, batch instances don't get a scheduler.
+    TaskScheduler task_scheduler{ *file_service, thread_tuning.get(), options.task_workers };
+    BindTaskScheduler(host, &task_scheduler);
+
     bstk::OSWindow mainwindow = oscontext->CreateWindow();
-    bstk::EngineModule module = oscontext->EngineLoad(argv[1], (argc > 2) ? argv[2] : "build.lock");
+    bstk::EngineModule module = oscontext->EngineLoad(options.module_path, options.lockfile);
     bstk::EngineInterface* interface = &module.interface;
+    if (interface->BindHost)
+        interface->BindHost(&host);
+
+    std::unique_ptr<ModuleMemoryTracker> module_memory = CreateModuleMemoryTracker();
+    module_memory->OnLoad(module.loaded_path, module.generation);
+
+    std::unique_ptr<ModulePrefaulter> prefaulter = CreateModulePrefaulter(options.prefault);
+    prefaulter->Prefault(module.loaded_path, module.generation);
+
+    std::unique_ptr<HotPatcher> hot_patcher = nullptr;
+    // Patched code may jump into any generation, none of them is released in patch mode.
+    std::vector<bstk::PlatformData> retained_modules = {};
+    if (options.hot_patch)
+    {
+        hot_patcher = CreateHotPatcher();
+        if (hot_patcher)
+            hot_patcher->OnLoad(module.loaded_path, module.generation);
+        else
+            std::cout << "[WARNING] hot patching unavailable" << std::endl;
+    }
+
+    std::unique_ptr<SamplingProfiler> profiler = nullptr;
+    if (!options.profile_output.empty())
+    {
+        profiler = CreateSamplingProfiler(options.profile_frequency);
+        profiler->RegisterModule(module.loaded_path, module.path, module.generation);
+    }
     bstk::EngineInterface::context_t* engine = interface->Create(&mainwindow);
+    if (interface->WarmUp)
+        interface->WarmUp(engine);
+    if (interface->StartTasks)
+        interface->StartTasks(engine);
+
+    FrameStats frame_stats{ options.hitch_threshold_us };
+
+    FrameControl control{};
+    control.fps_cap = options.fps_cap;
+    std::unique_ptr<ControlServer> control_server = nullptr;
+    if (!options.control_socket.empty())
+    {
+        control_server = CreateControlServer(options.control_socket);
+        if (!control_server)
+            std::cout << "[WARNING] control channel unavailable" << std::endl;
+    }
 
     iotk::input_t inputState{};
     StdClock::time_point last_frame_begin = StdClock::now();
+    StdClock::time_point stats_frame_begin = last_frame_begin;
 
     while (oscontext->PumpEvents(mainwindow, inputState))
     {
-        if (oscontext->EngineReloadRequired(module))
+        if (control_server)
+            HandleControlCommands(*control_server, control, frame_stats, profiler.get());
+
+        if (build_driver)
+            build_driver->Update(BuildDriver::Clock::now());
+
+        bool reloaded = false;
+        bool const reload_requested = control.reload_requested;
+        control.reload_requested = false;
+        if (reload_requested || oscontext->EngineReloadRequired(module))
         {
+            std::string const stale_path = module.loaded_path;
+            uint32_t const stale_generation = module.generation;
+
+            if (profiler)
+                profiler->BeginModuleChange();
             bstk::PlatformData stale_module = oscontext->EngineReloadModule(module);
+            if (profiler)
+                profiler->EndModuleChange();
+            bool patched = false;
             if (stale_module)
             {
+                // Suspended tasks resume into the code that created them, which is about to go away or be patched.
+                uint32_t const dropped_tasks = task_scheduler.DropAll();
+                if (dropped_tasks > 0)
+                    LoaderLog(bstk::kLogInfo, "dropped {} tasks of generation {}", dropped_tasks, stale_generation);
+                prefaulter->Prefault(module.loaded_path, module.generation);
+                // Before any new code runs so that it already sees the live data.
+                patched = hot_patcher && hot_patcher->Patch(module.loaded_path, module.generation);
+                if (interface->BindHost)
+                    interface->BindHost(&host);
                 interface->Reload(engine);
+                if (interface->WarmUp)
+                    interface->WarmUp(engine);
+                if (interface->StartTasks)
+                    interface->StartTasks(engine);
                 last_frame_begin = StdClock::now();
-                oscontext->EngineReleasePlatformData(stale_module);
+                if (profiler)
+                    profiler->RegisterModule(module.loaded_path, module.path, module.generation);
+                if (hot_patcher)
+                {
+                    retained_modules.push_back(stale_module);
+                }
+                else
+                {
+                    if (profiler)
+                        profiler->OnModuleUnload();
+                    // Queued messages may still point to the stale generation's format strings.
+                    logger.Flush();
+                    if (profiler)
+                        profiler->BeginModuleChange();
+                    oscontext->EngineReleasePlatformData(stale_module);
+                    if (profiler)
+                        profiler->EndModuleChange();
+                    module_memory->OnUnload(stale_path, stale_generation);
+                }
+                module_memory->OnLoad(module.loaded_path, module.generation);
+                reloaded = true;
+                if (build_driver)
+                    build_driver->OnReload(BuildDriver::Clock::now());
+            }
+
+            if (reload_requested && control_server)
+            {
+                if (stale_module)
+                    control_server->Ok(control.reload_client, "generation " + std::to_string(module.generation)
+                                                              + (patched ? " patched" : ""));
+                else
+                    control_server->Error(control.reload_client, "reload failed");
+                control.reload_client = 0;
             }
         }
 
+        bool const stepping = control.pending_steps > 0;
+        if (control.paused && !stepping)
+        {
+            // Events and the control channel are still serviced, the engine doesn't see time pass.
+            // Reads keep completing and samples keep being drained, only the engine is held.
+            file_service->Update();
+            if (profiler)
+                profiler->Drain();
+            inputState.wheel_delta = 0;
+            iotk::ClearEdges(inputState);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            last_frame_begin = StdClock::now();
+            stats_frame_begin = last_frame_begin;
+            continue;
+        }
+
         StdClock::time_point frame_marker = last_frame_begin;
         last_frame_begin = StdClock::now();
         float measured_time = static_cast<float>(
             std::chrono::duration_cast<std::chrono::milliseconds>(last_frame_begin-frame_marker)
             .count());
 
-        inputState.time_delta = measured_time / 1000.f;
+        // Stepped frames use a fixed time step so that they are reproducible.
+        inputState.time_delta = stepping ? control.step_time_step : measured_time / 1000.f;
+
+        file_service->Update();
 
+        std::vector<char const*> const& changed_assets = asset_watcher->Update(AssetWatcher::Clock::now());
+        if (!changed_assets.empty() && interface->AssetsChanged)
+            interface->AssetsChanged(engine, changed_assets.data(), (uint32_t)changed_assets.size());
+
+        prefaulter->BeginFrame();
+        StdClock::time_point const logic_begin = StdClock::now();
+        task_scheduler.RunPhase(bstk::kTaskPhaseFrameBegin);
         bool keep_running = interface->LogicUpdate(engine, &inputState);
+        if (keep_running)
+            task_scheduler.RunPhase(bstk::kTaskPhaseAfterLogic);
+        StdClock::time_point const logic_end = StdClock::now();
+        frame_stats.RecordPhase(kLogicUpdate, ElapsedMicroseconds(logic_begin, logic_end), reloaded);
         if (!keep_running)
             break;
 
         interface->DrawFrame(engine, &mainwindow);
+        task_scheduler.RunPhase(bstk::kTaskPhaseFrameEnd);
+        StdClock::time_point const draw_end = StdClock::now();
+        frame_stats.RecordPhase(kDrawFrame, ElapsedMicroseconds(logic_end, draw_end), reloaded);
+        prefaulter->EndFrame(ElapsedMicroseconds(logic_begin, draw_end));
+
+        // Unlike measured_time, this isn't reset by reloads so that their cost shows up.
+        uint64_t const frame_us = ElapsedMicroseconds(stats_frame_begin, draw_end);
+        frame_stats.RecordFrame(frame_us, reloaded);
+        thread_tuning->OnFrame(frame_us);
+        stats_frame_begin = draw_end;
+
+        if (build_driver)
+            build_driver->OnFrameEnd(BuildDriver::Clock::now());
+
+        if (profiler)
+            profiler->Drain();
 
         inputState.wheel_delta = 0;
+        iotk::ClearEdges(inputState);
+        scratch_allocator.EndFrame();
+
+        if (stepping && --control.pending_steps == 0 && control.step_client)
+        {
+            control_server->Ok(control.step_client, "frame " + std::to_string(frame_stats.frame_index));
+            control.step_client = 0;
+        }
+
+        if (control.fps_cap > 0)
+        {
+            std::this_thread::sleep_until(
+                last_frame_begin + std::chrono::nanoseconds(1000000000ull / control.fps_cap));
+            // Limiter idle time isn't frame cost.
+            stats_frame_begin = StdClock::now();
+        }
     }
 
+    task_scheduler.DropAll();
     interface->Shutdown(engine);
+    // Reports below are written directly.
+    logger.Flush();
+
+    if (profiler)
+        profiler->WriteFolded(options.profile_output);
+
+    if (build_driver)
+        build_driver->PrintReport();
+
+    if (hot_patcher)
+        hot_patcher->PrintReport();
+
+    scratch_allocator.PrintReport();
+    module_memory->PrintReport();
+    prefaulter->PrintReport();
+    thread_tuning->PrintReport();
+    task_scheduler.PrintReport();
+
+    if (options.stats_csv.empty())
+        frame_stats.PrintReport();
+    else
+        frame_stats.WriteCSV(options.stats_csv);
 
     return 0;
 }
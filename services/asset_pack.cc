@@ -0,0 +1,221 @@
+#include "asset_pack.hpp"
+#include "async_logger.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#if defined(__unix__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(LOADER_HAS_LZ4)
+#include <lz4.h>
+#endif
+
+static bool ValidatePack(MappedPack const& _pack)
+{
+    if (_pack.size < sizeof(pack::Header))
+        return false;
+
+    pack::Header const& header = _pack.header();
+    if (std::memcmp(header.magic, pack::kMagic, sizeof(pack::kMagic)) != 0
+        || header.version != pack::kVersion
+        || header.file_size != _pack.size)
+        return false;
+
+    // Offsets are checked before being added to, a crafted one would wrap around.
+    if (header.entries_offset > _pack.size || header.buckets_offset > _pack.size || header.strings_offset > _pack.size)
+        return false;
+    uint64_t const entries_end = header.entries_offset + (uint64_t)header.entry_count * sizeof(pack::Entry);
+    uint64_t const buckets_end = header.buckets_offset + (uint64_t)header.bucket_count * sizeof(uint32_t);
+    if (entries_end > _pack.size || buckets_end > _pack.size)
+        return false;
+    if (header.bucket_count == 0 || (header.bucket_count & (header.bucket_count - 1)) != 0)
+        return false;
+
+    pack::Entry const* entries = _pack.entries();
+    for (uint32_t index = 0; index < header.entry_count; ++index)
+    {
+        pack::Entry const& entry = entries[index];
+        if (entry.offset > _pack.size || entry.stored_size > _pack.size - entry.offset
+            || (uint64_t)entry.path_offset + entry.path_length > _pack.size - header.strings_offset)
+            return false;
+        // Uncompressed entries are handed out as is, their size is the stored one.
+        if (!(entry.flags & pack::kLZ4) && entry.size != entry.stored_size)
+            return false;
+#if defined(LOADER_HAS_LZ4)
+        // Find allocates size bytes up front, and LZ4 takes both sizes as int.
+        if ((entry.flags & pack::kLZ4)
+            && (entry.size > LZ4_MAX_INPUT_SIZE
+                || entry.stored_size > (uint64_t)LZ4_compressBound((int)entry.size)))
+            return false;
+#endif
+    }
+
+    return true;
+}
+
+static void ReleasePack(MappedPack& _pack)
+{
+#if defined(__unix__)
+    if (_pack.mapped)
+    {
+        munmap((void*)_pack.memory, _pack.size);
+        return;
+    }
+#endif
+    delete[] _pack.memory;
+}
+
+AssetPacks::~AssetPacks()
+{
+    for (MappedPack& mapped_pack : packs)
+        ReleasePack(mapped_pack);
+}
+
+bool AssetPacks::Open(std::string const& _path)
+{
+    MappedPack mapped_pack{ _path, nullptr, 0, false };
+
+#if defined(__unix__)
+    int const fd = open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LoaderLog(bstk::kLogError, "couldn't open pack {}", _path.c_str());
+        return false;
+    }
+
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+    mapped_pack.size = (uint64_t)file_stat.st_size;
+
+    int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+    flags |= MAP_POPULATE;
+#endif
+    void* memory = (mapped_pack.size > 0)
+        ? mmap(nullptr, mapped_pack.size, PROT_READ, flags, fd, 0)
+        : MAP_FAILED;
+    close(fd);
+
+    if (memory == MAP_FAILED)
+    {
+        LoaderLog(bstk::kLogError, "couldn't map pack {}", _path.c_str());
+        return false;
+    }
+    madvise(memory, mapped_pack.size, MADV_WILLNEED);
+
+    mapped_pack.memory = (uint8_t const*)memory;
+    mapped_pack.mapped = true;
+#else
+    FILE* file = std::fopen(_path.c_str(), "rb");
+    if (!file)
+    {
+        LoaderLog(bstk::kLogError, "couldn't open pack {}", _path.c_str());
+        return false;
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    mapped_pack.size = (uint64_t)std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+
+    uint8_t* memory = new uint8_t[mapped_pack.size];
+    mapped_pack.size = std::fread(memory, 1, mapped_pack.size, file);
+    std::fclose(file);
+    mapped_pack.memory = memory;
+#endif
+
+    if (!ValidatePack(mapped_pack))
+    {
+        LoaderLog(bstk::kLogError, "invalid pack {}", _path.c_str());
+        ReleasePack(mapped_pack);
+        return false;
+    }
+
+    packs.push_back(mapped_pack);
+
+    LoaderLog(bstk::kLogInfo, "mapped pack {} ({} entries)", _path.c_str(), mapped_pack.header().entry_count);
+    return true;
+}
+
+bool AssetPacks::Find(std::string_view _path, bstk::AssetView& _view)
+{
+    uint64_t const hash = pack::HashPath(_path);
+
+    for (MappedPack const& mapped_pack : packs)
+    {
+        pack::Header const& header = mapped_pack.header();
+        if (header.entry_count == 0)
+            continue;
+
+        uint32_t const mask = header.bucket_count - 1;
+        uint32_t const* buckets = mapped_pack.buckets();
+
+        for (uint32_t probe = 0; probe < header.bucket_count; ++probe)
+        {
+            uint32_t const entry_index = buckets[(hash + probe) & mask];
+            if (entry_index == pack::kEmptyBucket || entry_index >= header.entry_count)
+                break;
+
+            pack::Entry const& entry = mapped_pack.entries()[entry_index];
+            if (entry.path_hash != hash
+                || std::string_view(mapped_pack.strings() + entry.path_offset, entry.path_length) != _path)
+                continue;
+
+            uint8_t const* stored = mapped_pack.memory + entry.offset;
+            if (!(entry.flags & pack::kLZ4))
+            {
+                _view = bstk::AssetView{ stored, entry.size };
+                return true;
+            }
+
+            auto cached = decoded.find(&entry);
+            if (cached != decoded.end())
+            {
+                _view = bstk::AssetView{ cached->second.get(), entry.size };
+                return true;
+            }
+
+#if defined(LOADER_HAS_LZ4)
+            std::unique_ptr<uint8_t[]> buffer{ new (std::nothrow) uint8_t[entry.size] };
+            if (!buffer)
+            {
+                LoaderLog(bstk::kLogError, "couldn't allocate {} bytes for {}", entry.size, std::string(_path).c_str());
+                return false;
+            }
+            int const decoded_size = LZ4_decompress_safe((char const*)stored, (char*)buffer.get(),
+                                                         (int)entry.stored_size, (int)entry.size);
+            if (decoded_size < 0 || (uint64_t)decoded_size != entry.size)
+            {
+                LoaderLog(bstk::kLogError, "corrupted pack entry {}", std::string(_path).c_str());
+                return false;
+            }
+
+            _view = bstk::AssetView{ buffer.get(), entry.size };
+            decoded.emplace(&entry, std::move(buffer));
+            return true;
+#else
+            LoaderLog(bstk::kLogError, "{} is LZ4 compressed, loader built without LZ4", std::string(_path).c_str());
+            return false;
+#endif
+        }
+    }
+
+    return false;
+}
+
+static bool HostFindAsset(void* _packs, char const* _path, bstk::AssetView* _view)
+{
+    return ((AssetPacks*)_packs)->Find(_path, *_view);
+}
+
+void BindAssetPacks(bstk::HostServices& _host, AssetPacks* _packs)
+{
+    _host.asset_packs = _packs;
+    _host.FindAsset = HostFindAsset;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "loader/bstk.hpp"
+
+// Pack layout, shared with tools/packer.cc :
+//   pack::Header
+//   pack::Entry[entry_count]
+//   uint32_t buckets[bucket_count]   open addressing on the path hash, kEmptyBucket when unused
+//   path strings, not null terminated
+//   entry data, each entry starts on a kAlignment boundary
+namespace pack {
+
+constexpr char kMagic[4] = { 'M', 'P', 'A', 'K' };
+constexpr uint32_t kVersion = 1u;
+constexpr uint64_t kAlignment = 64u;
+constexpr uint32_t kEmptyBucket = 0xffffffffu;
+
+enum fEntryFlags
+{
+    kLZ4 = 1u << 0
+};
+
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t bucket_count;
+    uint64_t entries_offset;
+    uint64_t buckets_offset;
+    uint64_t strings_offset;
+    uint64_t file_size;
+};
+
+struct Entry
+{
+    uint64_t path_hash;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t stored_size;
+    uint32_t path_offset;
+    uint32_t path_length;
+    uint32_t flags;
+    uint32_t padding;
+};
+
+// FNV-1a
+inline uint64_t HashPath(std::string_view _path)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : _path)
+    {
+        hash ^= (uint8_t)c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline uint32_t BucketCount(uint32_t _entry_count)
+{
+    uint32_t count = 16u;
+    while (count < _entry_count * 2u)
+        count <<= 1;
+    return count;
+}
+
+} // namespace pack
+
+struct MappedPack
+{
+    std::string path;
+    uint8_t const* memory;
+    uint64_t size;
+    bool mapped;
+
+    pack::Header const& header() const { return *(pack::Header const*)memory; }
+    pack::Entry const* entries() const { return (pack::Entry const*)(memory + header().entries_offset); }
+    uint32_t const* buckets() const { return (uint32_t const*)(memory + header().buckets_offset); }
+    char const* strings() const { return (char const*)(memory + header().strings_offset); }
+};
+
+// Packs mapped once at startup, engines get pointers straight into the mapping.
+// Compressed entries are decoded on first access and kept until shutdown.
+struct AssetPacks
+{
+    AssetPacks() = default;
+    ~AssetPacks();
+    AssetPacks(AssetPacks const&) = delete;
+    AssetPacks& operator=(AssetPacks const&) = delete;
+
+    bool Open(std::string const& _path);
+    bool Find(std::string_view _path, bstk::AssetView& _view);
+
+    std::vector<MappedPack> packs = {};
+    std::unordered_map<pack::Entry const*, std::unique_ptr<uint8_t[]>> decoded = {};
+};
+
+void BindAssetPacks(bstk::HostServices& _host, AssetPacks* _packs);
@@ -0,0 +1,62 @@
+#include "asset_watcher.hpp"
+
+#include <algorithm>
+
+#if defined(__linux__)
+std::unique_ptr<AssetWatcher> CreateInotifyAssetWatcher();
+#endif
+
+void AssetWatcher::Notify(std::string const& _path, Clock::time_point _now)
+{
+    if (pending.empty())
+        first_change = _now;
+    last_change = _now;
+
+    pending.insert(_path);
+}
+
+std::vector<char const*> const& AssetWatcher::Update(Clock::time_point _now)
+{
+    batch_paths.clear();
+    batch.clear();
+
+    PollEvents();
+
+    if (pending.empty())
+        return batch_paths;
+
+    bool const settled = (_now - last_change) >= debounce;
+    bool const overdue = (_now - first_change) >= max_delay;
+    if (!settled && !overdue)
+        return batch_paths;
+
+    batch.assign(pending.begin(), pending.end());
+    pending.clear();
+    std::sort(batch.begin(), batch.end());
+
+    batch_paths.reserve(batch.size());
+    for (std::string const& path : batch)
+        batch_paths.push_back(path.c_str());
+
+    return batch_paths;
+}
+
+std::unique_ptr<AssetWatcher> CreateAssetWatcher()
+{
+#if defined(__linux__)
+    if (std::unique_ptr<AssetWatcher> watcher = CreateInotifyAssetWatcher())
+        return watcher;
+#endif
+    return std::unique_ptr<AssetWatcher>(new AssetWatcher());
+}
+
+static bool HostWatchAssets(void* _watcher, char const* _directory)
+{
+    return ((AssetWatcher*)_watcher)->Watch(_directory);
+}
+
+void BindAssetWatcher(bstk::HostServices& _host, AssetWatcher* _watcher)
+{
+    _host.asset_watcher = _watcher;
+    _host.WatchAssets = HostWatchAssets;
+}
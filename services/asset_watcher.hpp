@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "loader/bstk.hpp"
+
+// Watches engine-registered asset directories and batches changed paths.
+// A batch is only handed out once no new change arrived for the debounce delay,
+// so that editors writing a file in several steps produce a single notification.
+struct AssetWatcher
+{
+    using Clock = std::chrono::steady_clock;
+
+    AssetWatcher() = default;
+    virtual ~AssetWatcher() = default;
+    AssetWatcher(AssetWatcher const&) = delete;
+    AssetWatcher& operator=(AssetWatcher const&) = delete;
+
+    virtual bool Watch(std::string const& _directory) { (void)_directory; return false; }
+    // Returns the changed paths once the burst settled, the pointers stay valid until the next call.
+    std::vector<char const*> const& Update(Clock::time_point _now);
+
+    virtual void PollEvents() {}
+    void Notify(std::string const& _path, Clock::time_point _now);
+
+    Clock::duration debounce = std::chrono::milliseconds(100);
+    // Flushes anyway if changes keep coming for that long.
+    Clock::duration max_delay = std::chrono::seconds(1);
+
+    std::unordered_set<std::string> pending = {};
+    Clock::time_point first_change = {};
+    Clock::time_point last_change = {};
+
+    std::vector<std::string> batch = {};
+    std::vector<char const*> batch_paths = {};
+};
+
+// inotify backed on Linux, never reports anything elsewhere.
+std::unique_ptr<AssetWatcher> CreateAssetWatcher();
+
+void BindAssetWatcher(bstk::HostServices& _host, AssetWatcher* _watcher);
@@ -0,0 +1,250 @@
+#include "async_logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+static AsyncLogger* g_loader_logger = nullptr;
+
+static_assert(sizeof(AsyncLogger::Slot) == 256, "log slots are meant to span four cache lines");
+
+// Strings share the slot's text area and get truncated once it is full.
+static void EncodeMessage(AsyncLogger::Slot& _slot, bstk::eLogLevel _level, char const* _format,
+                          bstk::LogArg const* _args, uint32_t _arg_count)
+{
+    _slot.format = _format;
+    _slot.level = (uint8_t)_level;
+    _slot.arg_count = (uint8_t)std::min(_arg_count, AsyncLogger::kMaxArgs);
+    _slot.text_size = 0;
+
+    for (uint32_t index = 0; index < _slot.arg_count; ++index)
+    {
+        bstk::LogArg const& arg = _args[index];
+        _slot.types[index] = (uint8_t)arg.type;
+
+        switch (arg.type)
+        {
+        case bstk::kLogArgSigned:
+            _slot.values[index] = (uint64_t)arg.signed_value;
+            break;
+        case bstk::kLogArgUnsigned:
+            _slot.values[index] = arg.unsigned_value;
+            break;
+        case bstk::kLogArgDouble:
+            std::memcpy(&_slot.values[index], &arg.double_value, sizeof(double));
+            break;
+        case bstk::kLogArgPointer:
+            _slot.values[index] = (uint64_t)(uintptr_t)arg.pointer_value;
+            break;
+        case bstk::kLogArgString:
+        {
+            char const* string = arg.string_value ? arg.string_value : "(null)";
+            std::size_t const length = strnlen(string, AsyncLogger::kTextSize - _slot.text_size);
+            std::memcpy(_slot.text + _slot.text_size, string, length);
+            _slot.values[index] = ((uint64_t)_slot.text_size << 32) | (uint64_t)length;
+            _slot.text_size = (uint16_t)(_slot.text_size + length);
+            break;
+        }
+        default:
+            _slot.values[index] = 0;
+            break;
+        }
+    }
+}
+
+static void AppendArg(AsyncLogger::Slot const& _slot, uint32_t _index, std::string& _output)
+{
+    uint64_t const value = _slot.values[_index];
+    char buffer[32];
+    int length = 0;
+
+    switch (_slot.types[_index])
+    {
+    case bstk::kLogArgSigned:
+        length = std::snprintf(buffer, sizeof(buffer), "%" PRId64, (int64_t)value);
+        break;
+    case bstk::kLogArgUnsigned:
+        length = std::snprintf(buffer, sizeof(buffer), "%" PRIu64, value);
+        break;
+    case bstk::kLogArgDouble:
+    {
+        double double_value;
+        std::memcpy(&double_value, &value, sizeof(double));
+        length = std::snprintf(buffer, sizeof(buffer), "%g", double_value);
+        break;
+    }
+    case bstk::kLogArgPointer:
+        length = std::snprintf(buffer, sizeof(buffer), "%p", (void const*)(uintptr_t)value);
+        break;
+    case bstk::kLogArgString:
+        _output.append(_slot.text + (value >> 32), (std::size_t)(value & 0xffffffffu));
+        return;
+    default:
+        break;
+    }
+
+    if (length > 0)
+        _output.append(buffer, std::min<std::size_t>((std::size_t)length, sizeof(buffer) - 1));
+}
+
+static void FormatMessage(AsyncLogger::Slot const& _slot, std::string& _output)
+{
+    if (_slot.level == bstk::kLogWarning)
+        _output += "[WARNING] ";
+    else if (_slot.level == bstk::kLogError)
+        _output += "[ERROR] ";
+
+    uint32_t arg_index = 0;
+    for (char const* cursor = _slot.format; *cursor; ++cursor)
+    {
+        if (cursor[0] == '{' && cursor[1] == '}')
+        {
+            ++cursor;
+            if (arg_index < _slot.arg_count)
+                AppendArg(_slot, arg_index++, _output);
+            else
+                _output += "{?}";
+            continue;
+        }
+        _output += *cursor;
+    }
+    _output += '\n';
+}
+
+AsyncLogger::AsyncLogger(uint32_t _slot_count)
+{
+    uint64_t slot_count = 1;
+    while (slot_count < std::max(_slot_count, 2u))
+        slot_count <<= 1;
+
+    mask = slot_count - 1;
+    slots.reset(new Slot[slot_count]);
+    for (uint64_t index = 0; index < slot_count; ++index)
+        slots[index].sequence.store(index, std::memory_order_relaxed);
+
+    flusher = std::thread([this]() { FlusherMain(); });
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop.store(true, std::memory_order_release);
+    flusher.join();
+}
+
+// Bounded MPMC queue (Vyukov) with a single consumer : a slot's sequence tells whether it
+// is free for the producer at that position or published for the consumer.
+bool AsyncLogger::Push(bstk::eLogLevel _level, char const* _format, bstk::LogArg const* _args, uint32_t _arg_count)
+{
+    uint64_t position = enqueue_position.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Slot& slot = slots[position & mask];
+        uint64_t const sequence = slot.sequence.load(std::memory_order_acquire);
+        int64_t const difference = (int64_t)(sequence - position);
+
+        if (difference == 0)
+        {
+            if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                EncodeMessage(slot, _level, _format, _args, _arg_count);
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            dropped_count.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            position = enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncLogger::Flush()
+{
+    uint64_t const target = enqueue_position.load(std::memory_order_acquire);
+    while (written_position.load(std::memory_order_acquire) < target)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+void AsyncLogger::FlusherMain()
+{
+    std::string output{};
+    uint64_t read_position = 0;
+    uint64_t reported_drops = 0;
+
+    for (;;)
+    {
+        bool const stopping = stop.load(std::memory_order_acquire);
+
+        uint64_t const first_position = read_position;
+        for (;;)
+        {
+            Slot& slot = slots[read_position & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != read_position + 1)
+                break;
+
+            FormatMessage(slot, output);
+            slot.sequence.store(read_position + mask + 1, std::memory_order_release);
+            ++read_position;
+        }
+
+        uint64_t const drops = dropped_count.load(std::memory_order_relaxed);
+        if (drops != reported_drops)
+        {
+            output += "[WARNING] logger dropped " + std::to_string(drops - reported_drops) + " messages\n";
+            reported_drops = drops;
+        }
+
+        if (!output.empty())
+        {
+            std::fwrite(output.data(), 1, output.size(), stdout);
+            std::fflush(stdout);
+            output.clear();
+        }
+        written_position.store(read_position, std::memory_order_release);
+
+        if (stopping)
+            break;
+        if (read_position == first_position)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void InstallLoaderLogger(AsyncLogger* _logger)
+{
+    g_loader_logger = _logger;
+}
+
+void LoaderLogArgs(bstk::eLogLevel _level, char const* _format, bstk::LogArg const* _args, uint32_t _arg_count)
+{
+    if (g_loader_logger)
+    {
+        g_loader_logger->Push(_level, _format, _args, _arg_count);
+        return;
+    }
+
+    AsyncLogger::Slot slot{};
+    EncodeMessage(slot, _level, _format, _args, _arg_count);
+    std::string output{};
+    FormatMessage(slot, output);
+    std::fwrite(output.data(), 1, output.size(), stdout);
+    std::fflush(stdout);
+}
+
+static void HostLog(void* _logger, bstk::eLogLevel _level, char const* _format,
+                    bstk::LogArg const* _args, uint32_t _arg_count)
+{
+    ((AsyncLogger*)_logger)->Push(_level, _format, _args, _arg_count);
+}
+
+void BindAsyncLogger(bstk::HostServices& _host, AsyncLogger* _logger)
+{
+    _host.logger = _logger;
+    _host.Log = HostLog;
+}
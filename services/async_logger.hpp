@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "loader/bstk.hpp"
+
+// Multi-producer ring of fixed-size records drained by a background thread, which formats
+// and writes them. Producers only copy the format pointer and arguments into a slot, a full
+// ring drops the message (counted and reported) rather than blocking.
+struct AsyncLogger
+{
+    static constexpr uint32_t kMaxArgs = 8;
+    static constexpr uint32_t kTextSize = 152;
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> sequence;
+        char const* format;
+        uint8_t level;
+        uint8_t arg_count;
+        uint8_t types[kMaxArgs];
+        uint16_t text_size;
+        uint64_t values[kMaxArgs];
+        // Copied string arguments, values hold their offset and size.
+        char text[kTextSize];
+    };
+
+    explicit AsyncLogger(uint32_t _slot_count);
+    ~AsyncLogger();
+    AsyncLogger(AsyncLogger const&) = delete;
+    AsyncLogger& operator=(AsyncLogger const&) = delete;
+
+    // Safe from any thread, returns false when the message was dropped.
+    bool Push(bstk::eLogLevel _level, char const* _format, bstk::LogArg const* _args, uint32_t _arg_count);
+    // Waits until everything pushed so far is written, required before format strings go away.
+    void Flush();
+
+    void FlusherMain();
+
+    uint64_t mask;
+    std::unique_ptr<Slot[]> slots;
+
+    alignas(64) std::atomic<uint64_t> enqueue_position{ 0 };
+    alignas(64) std::atomic<uint64_t> written_position{ 0 };
+    std::atomic<uint64_t> dropped_count{ 0 };
+    std::atomic<bool> stop{ false };
+    std::thread flusher;
+};
+
+// Loader-side messages go through the installed logger, straight to stdout without one.
+void InstallLoaderLogger(AsyncLogger* _logger);
+void LoaderLogArgs(bstk::eLogLevel _level, char const* _format, bstk::LogArg const* _args, uint32_t _arg_count);
+
+template <typename... Args>
+inline void LoaderLog(bstk::eLogLevel _level, char const* _format, Args const&... _args)
+{
+    bstk::LogArg const args[] = { bstk::LogArg(_args)..., bstk::LogArg() };
+    LoaderLogArgs(_level, _format, args, (uint32_t)sizeof...(Args));
+}
+
+void BindAsyncLogger(bstk::HostServices& _host, AsyncLogger* _logger);
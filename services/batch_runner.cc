@@ -0,0 +1,170 @@
+#include "batch_runner.hpp"
+
+#include "file_service.hpp"
+#include "scratch_allocator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using BatchClock = std::chrono::steady_clock;
+
+// File, watcher and pack services aren't thread safe, engine threads go through a lock.
+static std::mutex g_host_mutex;
+static bstk::HostServices g_host_base;
+
+static bool SerializedReadFile(void* _service, bstk::FileRequest* _request)
+{
+    std::lock_guard<std::mutex> lock{ g_host_mutex };
+    return g_host_base.ReadFile(_service, _request);
+}
+
+static void SerializedReleaseFile(void* _service, bstk::FileRequest* _request)
+{
+    std::lock_guard<std::mutex> lock{ g_host_mutex };
+    g_host_base.ReleaseFile(_service, _request);
+}
+
+static bool SerializedWatchAssets(void* _watcher, char const* _directory)
+{
+    std::lock_guard<std::mutex> lock{ g_host_mutex };
+    return g_host_base.WatchAssets(_watcher, _directory);
+}
+
+static bool SerializedFindAsset(void* _packs, char const* _path, bstk::AssetView* _view)
+{
+    std::lock_guard<std::mutex> lock{ g_host_mutex };
+    return g_host_base.FindAsset(_packs, _path, _view);
+}
+
+static bstk::HostServices SerializeHost(bstk::HostServices const& _host)
+{
+    g_host_base = _host;
+
+    bstk::HostServices host = _host;
+    host.ReadFile = SerializedReadFile;
+    host.ReleaseFile = SerializedReleaseFile;
+    host.WatchAssets = SerializedWatchAssets;
+    host.FindAsset = SerializedFindAsset;
+    return host;
+}
+
+struct BatchInstance
+{
+    bstk::EngineInterface::context_t* engine;
+    iotk::input_t input;
+    bool running;
+};
+
+static double RunPass(bstk::EngineInterface const& _interface, bstk::HostServices const& _host,
+                      FileService& _file_service, ScratchAllocator& _scratch_allocator,
+                      BatchOptions const& _options, uint32_t _thread_count, uint64_t& _frames_stepped)
+{
+    bstk::OSWindow const headless_window{ 0, 0, { _options.window_size[0], _options.window_size[1] }, nullptr };
+    std::vector<bstk::OSWindow> windows(_options.instance_count, headless_window);
+
+    std::vector<BatchInstance> instances(_options.instance_count);
+    for (uint32_t index = 0; index < _options.instance_count; ++index)
+    {
+        instances[index].engine = _interface.Create(&windows[index]);
+        instances[index].input = iotk::input_t{};
+        instances[index].input.time_delta = _options.time_step;
+        instances[index].running = true;
+    }
+
+    std::atomic<uint32_t> next_instance{ 0 };
+    std::atomic<uint64_t> frames_stepped{ 0 };
+
+    auto end_frame = [&]() noexcept {
+        next_instance.store(0, std::memory_order_relaxed);
+        _scratch_allocator.EndFrame();
+        _file_service.Update();
+    };
+    std::barrier frame_barrier{ (std::ptrdiff_t)_thread_count, end_frame };
+
+    auto worker = [&]() {
+        for (uint32_t frame = 0; frame < _options.frame_count; ++frame)
+        {
+            uint64_t stepped = 0;
+            for (uint32_t index = next_instance.fetch_add(1, std::memory_order_relaxed);
+                 index < _options.instance_count;
+                 index = next_instance.fetch_add(1, std::memory_order_relaxed))
+            {
+                BatchInstance& instance = instances[index];
+                if (!instance.running)
+                    continue;
+
+                instance.running = _interface.LogicUpdate(instance.engine, &instance.input);
+                if (instance.running)
+                    _interface.DrawFrame(instance.engine, &windows[index]);
+                iotk::ClearEdges(instance.input);
+                ++stepped;
+            }
+            frames_stepped.fetch_add(stepped, std::memory_order_relaxed);
+            frame_barrier.arrive_and_wait();
+        }
+    };
+
+    BatchClock::time_point const begin = BatchClock::now();
+
+    std::vector<std::thread> threads;
+    for (uint32_t thread_index = 1; thread_index < _thread_count; ++thread_index)
+    {
+        threads.emplace_back([&]() {
+            _host.ConfigureWorkerThread(_host.thread_tuning);
+            worker();
+        });
+    }
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    double const seconds = std::chrono::duration<double>(BatchClock::now() - begin).count();
+
+    for (BatchInstance& instance : instances)
+        _interface.Shutdown(instance.engine);
+
+    _frames_stepped = frames_stepped.load();
+    return seconds;
+}
+
+void RunBatch(bstk::EngineInterface const& _interface, bstk::HostServices const& _host,
+              FileService& _file_service, ScratchAllocator& _scratch_allocator,
+              BatchOptions const& _options)
+{
+    bstk::HostServices const host = SerializeHost(_host);
+    if (_interface.BindHost)
+        _interface.BindHost(&host);
+
+    uint32_t const max_threads = std::max(_options.thread_count, 1u);
+    std::vector<uint32_t> thread_counts;
+    for (uint32_t thread_count = 1; thread_count < max_threads; thread_count *= 2)
+        thread_counts.push_back(thread_count);
+    thread_counts.push_back(max_threads);
+
+    std::cout << "batch : " << _options.instance_count << " instances, "
+              << _options.frame_count << " frames" << std::endl;
+
+    double single_thread_fps = 0.0;
+    for (uint32_t thread_count : thread_counts)
+    {
+        uint64_t frames_stepped = 0;
+        double const seconds = RunPass(_interface, host, _file_service, _scratch_allocator, _options,
+                                       thread_count, frames_stepped);
+        double const fps = (seconds > 0.0) ? (double)frames_stepped / seconds : 0.0;
+        if (thread_count == 1)
+            single_thread_fps = fps;
+
+        double const speedup = (single_thread_fps > 0.0) ? fps / single_thread_fps : 0.0;
+        std::cout << "\t" << thread_count << " threads : " << fps << " frames/s"
+                  << " (" << frames_stepped << " frames in " << seconds << "s)"
+                  << " speedup " << speedup
+                  << " efficiency " << (speedup / thread_count) * 100.0 << "%"
+                  << std::endl;
+    }
+}
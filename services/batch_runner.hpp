@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+#include "loader/bstk.hpp"
+
+struct FileService;
+struct ScratchAllocator;
+
+// Runs many engine contexts from a single module load, without a window nor real time.
+// Contexts are stepped in lockstep frames, spread over a pool of threads; host services
+// are serviced between frames like the interactive loop does.
+struct BatchOptions
+{
+    uint32_t instance_count;
+    uint32_t frame_count;
+    uint32_t thread_count;
+    float time_step;
+    uint32_t window_size[2];
+};
+
+// Runs the batch once per thread count (1, 2, 4 ... thread_count) to report scaling.
+void RunBatch(bstk::EngineInterface const& _interface, bstk::HostServices const& _host,
+              FileService& _file_service, ScratchAllocator& _scratch_allocator,
+              BatchOptions const& _options);
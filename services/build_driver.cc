@@ -0,0 +1,186 @@
+#include "build_driver.hpp"
+#include "async_logger.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string_view>
+
+#if defined(__unix__)
+std::unique_ptr<BuildDriver> CreatePosixBuildDriver(std::string const& _command,
+                                                    std::unique_ptr<AssetWatcher> _watcher);
+#endif
+
+static double Milliseconds(BuildDriver::Clock::duration _duration)
+{
+    return std::chrono::duration<double, std::milli>(_duration).count();
+}
+
+// Editor swap files, backups and anything hidden never trigger a build. Only the part below
+// the watched directory is looked at, which may itself be under a hidden one or use "..".
+static bool IgnoredSourcePath(std::string_view _path, std::vector<std::string> const& _roots)
+{
+    std::size_t relative_begin = 0;
+    for (std::string const& root : _roots)
+    {
+        if (root.size() > relative_begin && _path.size() > root.size()
+            && _path.compare(0, root.size(), root) == 0 && _path[root.size()] == '/')
+            relative_begin = root.size();
+    }
+
+    std::string_view const relative = _path.substr(relative_begin);
+    std::size_t const name_begin = relative.find_last_of('/') + 1;
+    return relative.empty()
+        || relative.back() == '~'
+        || relative.find("/.") != std::string_view::npos
+        || relative.compare(name_begin, 1, "#") == 0;
+}
+
+BuildDriver::BuildDriver(std::string const& _command, std::unique_ptr<AssetWatcher> _watcher)
+    : command{ _command }, watcher{ std::move(_watcher) }
+{}
+
+bool BuildDriver::StartBuild(Clock::time_point _now)
+{
+    if (!SpawnBuild())
+        return false;
+
+    building = true;
+    current.build_start = _now;
+    LoaderLog(bstk::kLogInfo, "build started{}", current.restarts ? " (restarted)" : "");
+    return true;
+}
+
+void BuildDriver::Update(Clock::time_point _now)
+{
+    std::vector<char const*> const& changed = watcher->Update(_now);
+    bool const edited = std::any_of(changed.begin(), changed.end(),
+                                    [this](char const* _path) { return !IgnoredSourcePath(_path, source_directories); });
+
+    if (edited)
+    {
+        if (!building)
+        {
+            // Also drops an iteration whose build succeeded without leading to a reload.
+            current = Iteration{};
+            current.edit = watcher->first_change;
+            iteration_pending = true;
+            waiting_reload = false;
+            waiting_frame = false;
+            if (!StartBuild(_now))
+                iteration_pending = false;
+        }
+        else if (!cancelling)
+        {
+            // Keeps the earliest edit, that's the one the developer has been waiting on.
+            CancelBuild();
+            cancelling = true;
+            ++current.restarts;
+        }
+    }
+
+    bool success = false;
+    if (building && PollBuild(success))
+    {
+        building = false;
+        if (cancelling)
+        {
+            // The restarted build sees every edit made so far.
+            cancelling = false;
+            if (!StartBuild(_now))
+                iteration_pending = false;
+        }
+        else
+        {
+            current.build_end = _now;
+            if (success)
+            {
+                waiting_reload = true;
+            }
+            else
+            {
+                LoaderLog(bstk::kLogInfo, "build failed after {}ms", Milliseconds(_now - current.build_start));
+                iteration_pending = false;
+            }
+        }
+    }
+}
+
+void BuildDriver::OnReload(Clock::time_point _now)
+{
+    if (!waiting_reload)
+        return;
+
+    current.reload = _now;
+    waiting_reload = false;
+    waiting_frame = true;
+}
+
+void BuildDriver::OnFrameEnd(Clock::time_point _now)
+{
+    if (!waiting_frame)
+        return;
+
+    current.first_frame = _now;
+    history.push_back(current);
+    waiting_frame = false;
+    iteration_pending = false;
+
+    LoaderLog(bstk::kLogInfo,
+              "edit to reloaded frame {}ms (until build {}ms, build {}ms, reload {}ms, first frame {}ms, restarts {})",
+              Milliseconds(current.first_frame - current.edit),
+              Milliseconds(current.build_start - current.edit),
+              Milliseconds(current.build_end - current.build_start),
+              Milliseconds(current.reload - current.build_end),
+              Milliseconds(current.first_frame - current.reload),
+              current.restarts);
+}
+
+void BuildDriver::PrintReport() const
+{
+    if (history.empty())
+        return;
+
+    std::vector<double> totals;
+    for (Iteration const& iteration : history)
+        totals.push_back(Milliseconds(iteration.first_frame - iteration.edit));
+    std::sort(totals.begin(), totals.end());
+
+    std::cout << "edit to reloaded frame over " << totals.size() << " iterations :"
+              << " min " << totals.front() << "ms"
+              << " median " << totals[totals.size() / 2] << "ms"
+              << " max " << totals.back() << "ms"
+              << std::endl;
+}
+
+std::unique_ptr<BuildDriver> CreateBuildDriver(std::string const& _command,
+                                               std::vector<std::string> const& _source_directories)
+{
+#if defined(__unix__)
+    std::unique_ptr<AssetWatcher> watcher = CreateAssetWatcher();
+    // Saves are short bursts, no need to wait as long as for exported assets.
+    watcher->debounce = std::chrono::milliseconds(50);
+
+    std::vector<std::string> roots{};
+    for (std::string const& directory : _source_directories)
+    {
+        if (!watcher->Watch(directory))
+        {
+            std::cout << "[ERROR] couldn't watch sources in " << directory << std::endl;
+            return nullptr;
+        }
+        // Spelled like the watcher reports paths.
+        std::string root = directory;
+        while (root.size() > 1 && root.back() == '/')
+            root.pop_back();
+        roots.push_back(root);
+    }
+
+    std::unique_ptr<BuildDriver> driver = CreatePosixBuildDriver(_command, std::move(watcher));
+    driver->source_directories = std::move(roots);
+    return driver;
+#else
+    (void)_command;
+    (void)_source_directories;
+    return nullptr;
+#endif
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asset_watcher.hpp"
+
+struct ThreadTuning;
+
+// Rebuilds the module whenever its sources change and measures how long it takes
+// for an edit to show up in a frame : edit -> build start -> build end -> reload -> first frame.
+// A build still running when new edits arrive is cancelled and restarted.
+struct BuildDriver
+{
+    using Clock = AssetWatcher::Clock;
+
+    struct Iteration
+    {
+        Clock::time_point edit;
+        Clock::time_point build_start;
+        Clock::time_point build_end;
+        Clock::time_point reload;
+        Clock::time_point first_frame;
+        uint32_t restarts;
+    };
+
+    BuildDriver(std::string const& _command, std::unique_ptr<AssetWatcher> _watcher);
+    virtual ~BuildDriver() = default;
+    BuildDriver(BuildDriver const&) = delete;
+    BuildDriver& operator=(BuildDriver const&) = delete;
+
+    void Update(Clock::time_point _now);
+    void OnReload(Clock::time_point _now);
+    void OnFrameEnd(Clock::time_point _now);
+    void PrintReport() const;
+
+    bool StartBuild(Clock::time_point _now);
+
+    // Platform side, runs command in a shell of its own process group.
+    virtual bool SpawnBuild() { return false; }
+    // Asks the build to stop without waiting, PollBuild reports once it is gone.
+    virtual void CancelBuild() {}
+    // Returns true once the running build exited, _success tells how.
+    virtual bool PollBuild(bool& _success) { (void)_success; return false; }
+
+    std::string command;
+    std::unique_ptr<AssetWatcher> watcher;
+    // Changes are matched against the ignore rules relative to these.
+    std::vector<std::string> source_directories = {};
+    // Keeps builds off the frame thread's CPUs and priority, optional.
+    ThreadTuning const* thread_tuning = nullptr;
+
+    bool building = false;
+    // The running build was cancelled, a new one starts once it exited.
+    bool cancelling = false;
+    bool iteration_pending = false;
+    bool waiting_reload = false;
+    bool waiting_frame = false;
+    Iteration current = {};
+    std::vector<Iteration> history = {};
+};
+
+// Process management is only implemented for POSIX, nullptr elsewhere.
+std::unique_ptr<BuildDriver> CreateBuildDriver(std::string const& _command,
+                                               std::vector<std::string> const& _source_directories);
@@ -0,0 +1,218 @@
+#include "control_server.hpp"
+#include "async_logger.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// Anything longer isn't a command, the client gets dropped.
+static constexpr std::size_t kMaxLineLength = 4096;
+
+static bool PosixSetNonBlocking(int _fd)
+{
+    int const flags = fcntl(_fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(_fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+struct PosixControlServer : public ControlServer
+{
+    struct Client
+    {
+        uint64_t id;
+        int fd;
+        std::string input;
+        // Commands not answered yet, a client that stopped sending is closed once they are.
+        uint32_t pending_replies;
+        bool input_closed;
+    };
+
+    PosixControlServer(std::string const& _path, int _listen_fd) : path{ _path }, listen_fd{ _listen_fd } {}
+    ~PosixControlServer() override;
+
+    std::vector<Command> const& Poll() override;
+    void Write(uint64_t _client, std::string const& _text) override;
+    void OnReplied(uint64_t _client) override;
+
+    void CloseClient(std::size_t _index);
+
+    std::string path;
+    int listen_fd;
+    uint64_t next_client_id = 1;
+    std::vector<Client> clients = {};
+};
+
+PosixControlServer::~PosixControlServer()
+{
+    while (!clients.empty())
+        CloseClient(clients.size() - 1);
+    close(listen_fd);
+    unlink(path.c_str());
+}
+
+void PosixControlServer::CloseClient(std::size_t _index)
+{
+    close(clients[_index].fd);
+    clients.erase(clients.begin() + (std::ptrdiff_t)_index);
+}
+
+std::vector<ControlServer::Command> const& PosixControlServer::Poll()
+{
+    commands.clear();
+
+    for (;;)
+    {
+        int const fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+            break;
+        if (!PosixSetNonBlocking(fd))
+        {
+            close(fd);
+            continue;
+        }
+        clients.push_back(Client{ next_client_id++, fd, "", 0, false });
+    }
+
+    for (std::size_t index = 0; index < clients.size();)
+    {
+        Client& client = clients[index];
+
+        bool closed = false;
+        char buffer[512];
+        while (!client.input_closed)
+        {
+            ssize_t const received = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (received > 0)
+            {
+                client.input.append(buffer, (std::size_t)received);
+                continue;
+            }
+
+            // A half-close (printf cmd | nc -N) still expects the replies, an unterminated
+            // last line counts as a command.
+            if (received == 0)
+            {
+                client.input_closed = true;
+                if (!client.input.empty() && client.input.back() != '\n')
+                    client.input += '\n';
+            }
+            else
+            {
+                closed = (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+            }
+            break;
+        }
+
+        std::size_t line_end = 0;
+        while ((line_end = client.input.find('\n')) != std::string::npos)
+        {
+            std::istringstream line(client.input.substr(0, line_end));
+            client.input.erase(0, line_end + 1);
+
+            Command command{ client.id, {} };
+            std::string word;
+            while (line >> word)
+                command.words.push_back(word);
+            if (!command.words.empty())
+            {
+                commands.push_back(std::move(command));
+                ++client.pending_replies;
+            }
+        }
+
+        if (client.input.size() > kMaxLineLength)
+        {
+            LoaderLog(bstk::kLogWarning, "control client sent an oversized line, disconnecting");
+            closed = true;
+        }
+
+        if (closed || (client.input_closed && client.pending_replies == 0))
+            CloseClient(index);
+        else
+            ++index;
+    }
+
+    return commands;
+}
+
+void PosixControlServer::Write(uint64_t _client, std::string const& _text)
+{
+    for (std::size_t index = 0; index < clients.size(); ++index)
+    {
+        if (clients[index].id != _client)
+            continue;
+
+        // Replies are small, a client that lets its receive buffer fill up gets dropped
+        // rather than stalling the frame.
+        std::size_t offset = 0;
+        while (offset < _text.size())
+        {
+            ssize_t const sent = send(clients[index].fd, _text.data() + offset, _text.size() - offset,
+                                      MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+            {
+                CloseClient(index);
+                return;
+            }
+            offset += (std::size_t)sent;
+        }
+        return;
+    }
+}
+
+void PosixControlServer::OnReplied(uint64_t _client)
+{
+    for (std::size_t index = 0; index < clients.size(); ++index)
+    {
+        Client& client = clients[index];
+        if (client.id != _client)
+            continue;
+
+        if (client.pending_replies > 0)
+            --client.pending_replies;
+        if (client.input_closed && client.pending_replies == 0)
+            CloseClient(index);
+        return;
+    }
+}
+
+std::unique_ptr<ControlServer> CreateControlServer(std::string const& _path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (_path.size() >= sizeof(address.sun_path))
+    {
+        LoaderLog(bstk::kLogError, "control socket path too long {}", _path.c_str());
+        return nullptr;
+    }
+    std::memcpy(address.sun_path, _path.c_str(), _path.size() + 1);
+
+    int const fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        LoaderLog(bstk::kLogError, "couldn't create control socket (errno {})", errno);
+        return nullptr;
+    }
+
+    // Leftover from a previous run that didn't exit cleanly.
+    unlink(_path.c_str());
+
+    if (bind(fd, (sockaddr const*)&address, sizeof(address)) != 0
+        || listen(fd, 4) != 0
+        || !PosixSetNonBlocking(fd))
+    {
+        LoaderLog(bstk::kLogError, "couldn't listen on {} (errno {})", _path.c_str(), errno);
+        close(fd);
+        return nullptr;
+    }
+
+    LoaderLog(bstk::kLogInfo, "control channel listening on {}", _path.c_str());
+    return std::unique_ptr<ControlServer>(new PosixControlServer(_path, fd));
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Line based command channel over a UNIX domain socket, polled from the frame loop
+// without ever blocking it. Commands are whitespace separated words, every reply is
+// zero or more data lines followed by "ok" or "error <reason>".
+struct ControlServer
+{
+    struct Command
+    {
+        uint64_t client;
+        std::vector<std::string> words;
+    };
+
+    ControlServer() = default;
+    virtual ~ControlServer() = default;
+    ControlServer(ControlServer const&) = delete;
+    ControlServer& operator=(ControlServer const&) = delete;
+
+    // Accepts pending connections and returns the complete lines received since last call.
+    virtual std::vector<Command> const& Poll() { return commands; }
+
+    // Replies to clients that disconnected in the meantime are dropped.
+    virtual void Write(uint64_t _client, std::string const& _text) { (void)_client; (void)_text; }
+
+    // Every command is answered by exactly one Ok or Error.
+    void Ok(uint64_t _client, std::string const& _text = "")
+    {
+        Write(_client, _text.empty() ? "ok\n" : "ok " + _text + "\n");
+        OnReplied(_client);
+    }
+
+    void Error(uint64_t _client, std::string const& _reason)
+    {
+        Write(_client, "error " + _reason + "\n");
+        OnReplied(_client);
+    }
+
+    virtual void OnReplied(uint64_t _client) { (void)_client; }
+
+    std::vector<Command> commands = {};
+};
+
+#if defined(__unix__)
+std::unique_ptr<ControlServer> CreateControlServer(std::string const& _path);
+#else
+// UNIX domain sockets are only used on POSIX.
+inline std::unique_ptr<ControlServer> CreateControlServer(std::string const&)
+{
+    return nullptr;
+}
+#endif
@@ -0,0 +1,733 @@
+#include "hot_patcher.hpp"
+#include "async_logger.hpp"
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__x86_64__)
+static constexpr uint16_t kElfMachine = EM_X86_64;
+static constexpr uint32_t kGlobDatRelocation = R_X86_64_GLOB_DAT;
+static constexpr uint32_t kAbs64Relocation = R_X86_64_64;
+// jmp rel32, anything shorter can't hold a relocated displacement either.
+static constexpr uint64_t kShortestJump = 5;
+#else
+static constexpr uint16_t kElfMachine = EM_AARCH64;
+static constexpr uint32_t kGlobDatRelocation = R_AARCH64_GLOB_DAT;
+static constexpr uint32_t kAbs64Relocation = R_AARCH64_ABS64;
+// b imm26
+static constexpr uint64_t kShortestJump = 4;
+#endif
+
+struct ImageSymbol
+{
+    uintptr_t address;
+    uint64_t size;
+    bool function;
+};
+
+// Load time reference to a data symbol (GOT entry or absolute pointer).
+struct DataReference
+{
+    uintptr_t slot;
+    std::string name;
+    int64_t addend;
+};
+
+// Link time relocation of a code field, only kept in the file with -Wl,--emit-relocs.
+struct CodeRelocation
+{
+    uintptr_t address;
+    uint32_t type;
+    uint32_t size;
+    std::string target;
+    int64_t addend;
+};
+
+struct PatchImage
+{
+    std::string loaded_path;
+    uint32_t generation;
+    uintptr_t base;
+    uintptr_t relro_begin;
+    uintptr_t relro_end;
+
+    // Local symbols are keyed by <file>:<name>, names defined twice are left out.
+    std::unordered_map<std::string, ImageSymbol> symbols;
+    std::vector<DataReference> data_references;
+    // Sorted by address. Without them, code can't be compared across layouts.
+    std::vector<CodeRelocation> code_relocations;
+    bool code_relocated;
+    uint32_t ambiguous_count;
+    uint32_t private_data_count;
+};
+
+struct PatchRecord
+{
+    uint32_t generation;
+    bool patched;
+    uint32_t changed_functions;
+    uint32_t patched_sites;
+    uint32_t redirected_references;
+    double milliseconds;
+};
+
+// Bytes a relocation of _type rewrites.
+static uint32_t RelocatedBytes(uint32_t _type)
+{
+#if defined(__x86_64__)
+    switch (_type)
+    {
+    case R_X86_64_64:
+    case R_X86_64_PC64:
+    case R_X86_64_GOTOFF64:
+    case R_X86_64_DTPOFF64:
+    case R_X86_64_TPOFF64:
+        return 8;
+    case R_X86_64_16:
+    case R_X86_64_PC16:
+        return 2;
+    case R_X86_64_8:
+    case R_X86_64_PC8:
+        return 1;
+    default:
+        return 4;
+    }
+#else
+    switch (_type)
+    {
+    case R_AARCH64_ABS64:
+    case R_AARCH64_PREL64:
+        return 8;
+    case R_AARCH64_ABS16:
+    case R_AARCH64_PREL16:
+        return 2;
+    default:
+        return 4;
+    }
+#endif
+}
+
+// Write to apply while the target pages are unprotected.
+struct PatchWrite
+{
+    uintptr_t address;
+    std::size_t size;
+    uint8_t bytes[16];
+};
+
+struct ElfHotPatcher : public HotPatcher
+{
+    void OnLoad(std::string const& _loaded_path, uint32_t _generation) override;
+    bool Patch(std::string const& _loaded_path, uint32_t _generation) override;
+    void PrintReport() const override;
+
+    std::vector<PatchImage> images = {};
+    std::vector<PatchRecord> history = {};
+};
+
+static bool PosixImageBase(std::string const& _path, uintptr_t& _base)
+{
+    void* handle = dlopen(_path.c_str(), RTLD_NOW | RTLD_NOLOAD);
+    if (!handle)
+        return false;
+
+    link_map* map = nullptr;
+    bool const found = (dlinfo(handle, RTLD_DI_LINKMAP, &map) == 0) && map;
+    if (found)
+        _base = (uintptr_t)map->l_addr;
+    dlclose(handle);
+    return found;
+}
+
+// Symbols and dynamic relocations come from the file, the loaded image only provides the base.
+static bool ElfReadImage(uint8_t const* _file, std::size_t _file_size, PatchImage& _image)
+{
+    if (_file_size < sizeof(Elf64_Ehdr))
+        return false;
+
+    Elf64_Ehdr const& header = *(Elf64_Ehdr const*)_file;
+    if (std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0
+        || header.e_ident[EI_CLASS] != ELFCLASS64
+        || header.e_machine != kElfMachine
+        || header.e_shentsize != sizeof(Elf64_Shdr)
+        || header.e_phentsize != sizeof(Elf64_Phdr)
+        || header.e_shoff + (uint64_t)header.e_shnum * sizeof(Elf64_Shdr) > _file_size
+        || header.e_phoff + (uint64_t)header.e_phnum * sizeof(Elf64_Phdr) > _file_size)
+        return false;
+
+    Elf64_Shdr const* sections = (Elf64_Shdr const*)(_file + header.e_shoff);
+    Elf64_Phdr const* segments = (Elf64_Phdr const*)(_file + header.e_phoff);
+    auto const InFile = [_file_size](Elf64_Shdr const& _section) {
+        return _section.sh_type == SHT_NOBITS || _section.sh_offset + _section.sh_size <= _file_size;
+    };
+
+    for (uint16_t index = 0; index < header.e_phnum; ++index)
+    {
+        if (segments[index].p_type != PT_GNU_RELRO)
+            continue;
+        _image.relro_begin = _image.base + segments[index].p_vaddr;
+        _image.relro_end = _image.relro_begin + segments[index].p_memsz;
+    }
+
+    // The full symbol table also covers static functions, stripped modules only have .dynsym.
+    Elf64_Shdr const* symbol_section = nullptr;
+    Elf64_Shdr const* dynamic_symbol_section = nullptr;
+    for (uint16_t index = 0; index < header.e_shnum; ++index)
+    {
+        if (sections[index].sh_type == SHT_SYMTAB)
+            symbol_section = &sections[index];
+        else if (sections[index].sh_type == SHT_DYNSYM)
+            dynamic_symbol_section = &sections[index];
+    }
+    if (!symbol_section)
+        symbol_section = dynamic_symbol_section;
+    if (!symbol_section || !dynamic_symbol_section
+        || symbol_section->sh_link >= header.e_shnum || dynamic_symbol_section->sh_link >= header.e_shnum
+        || !InFile(*symbol_section) || !InFile(*dynamic_symbol_section)
+        || !InFile(sections[symbol_section->sh_link]) || !InFile(sections[dynamic_symbol_section->sh_link]))
+        return false;
+
+    Elf64_Shdr const& string_section = sections[symbol_section->sh_link];
+    char const* strings = (char const*)(_file + string_section.sh_offset);
+    auto const SymbolName = [](char const* _strings, Elf64_Shdr const& _section, uint32_t _offset) {
+        return (_offset < _section.sh_size) ? _strings + _offset : "";
+    };
+
+    std::unordered_set<std::string> ambiguous{};
+    std::string file_name = "";
+    // Relocation targets by symbol index, named like the symbols above.
+    std::vector<std::string> symbol_keys{};
+    Elf64_Sym const* symbols = (Elf64_Sym const*)(_file + symbol_section->sh_offset);
+    std::size_t const symbol_count = symbol_section->sh_size / sizeof(Elf64_Sym);
+    symbol_keys.resize(symbol_count);
+    Elf64_Shdr const* section_names = (header.e_shstrndx < header.e_shnum && InFile(sections[header.e_shstrndx]))
+        ? &sections[header.e_shstrndx] : nullptr;
+    for (std::size_t index = 1; index < symbol_count; ++index)
+    {
+        Elf64_Sym const& symbol = symbols[index];
+        uint8_t const type = ELF64_ST_TYPE(symbol.st_info);
+        uint8_t const binding = ELF64_ST_BIND(symbol.st_info);
+        char const* name = SymbolName(strings, string_section, symbol.st_name);
+
+        if (type == STT_SECTION && section_names && symbol.st_shndx < header.e_shnum)
+        {
+            symbol_keys[index] = std::string("section:") + SymbolName((char const*)(_file + section_names->sh_offset),
+                                                                      *section_names, sections[symbol.st_shndx].sh_name);
+        }
+        else
+        {
+            symbol_keys[index] = (binding == STB_LOCAL) ? file_name + ":" + name : std::string(name);
+        }
+
+        if (type == STT_FILE)
+        {
+            file_name = name;
+            continue;
+        }
+        if ((type != STT_FUNC && type != STT_OBJECT) || !name[0]
+            || symbol.st_shndx == SHN_UNDEF || symbol.st_shndx >= SHN_LORESERVE)
+            continue;
+
+        if (binding == STB_LOCAL && type == STT_OBJECT)
+        {
+            // Linker markers are empty, crtstuff's completed.0 is runtime bookkeeping.
+            bool const writable = symbol.st_shndx < header.e_shnum
+                && (sections[symbol.st_shndx].sh_flags & SHF_WRITE);
+            if (writable && symbol.st_size > 0 && std::strncmp(name, "completed.", 10) != 0)
+                ++_image.private_data_count;
+            continue;
+        }
+
+        std::string const key = (binding == STB_LOCAL) ? file_name + ":" + name : std::string(name);
+        ImageSymbol const image_symbol{ _image.base + symbol.st_value, symbol.st_size, type == STT_FUNC };
+        if (!_image.symbols.emplace(key, image_symbol).second)
+            ambiguous.insert(key);
+    }
+    for (std::string const& key : ambiguous)
+        _image.symbols.erase(key);
+    _image.ambiguous_count = (uint32_t)ambiguous.size();
+
+    // Relocations the linker resolved in code, they tell layout changes from code changes.
+    for (uint16_t index = 0; symbol_section->sh_type == SHT_SYMTAB && index < header.e_shnum; ++index)
+    {
+        Elf64_Shdr const& section = sections[index];
+        if (section.sh_type != SHT_RELA || &sections[section.sh_link] != symbol_section
+            || section.sh_info >= header.e_shnum || !(sections[section.sh_info].sh_flags & SHF_EXECINSTR)
+            || !InFile(section))
+            continue;
+
+        _image.code_relocated = true;
+        Elf64_Rela const* relocations = (Elf64_Rela const*)(_file + section.sh_offset);
+        std::size_t const relocation_count = section.sh_size / sizeof(Elf64_Rela);
+        for (std::size_t relocation_index = 0; relocation_index < relocation_count; ++relocation_index)
+        {
+            Elf64_Rela const& relocation = relocations[relocation_index];
+            uint32_t const type = (uint32_t)ELF64_R_TYPE(relocation.r_info);
+            uint64_t const symbol_index = ELF64_R_SYM(relocation.r_info);
+            if (type == 0)
+                continue;
+
+            _image.code_relocations.push_back(CodeRelocation{
+                _image.base + relocation.r_offset,
+                type,
+                RelocatedBytes(type),
+                (symbol_index < symbol_count) ? symbol_keys[symbol_index] : std::string(),
+                relocation.r_addend
+            });
+        }
+    }
+    std::sort(_image.code_relocations.begin(), _image.code_relocations.end(),
+              [](CodeRelocation const& _lhs, CodeRelocation const& _rhs) { return _lhs.address < _rhs.address; });
+
+    // Relocations against exported data, whether through the GOT or absolute pointers.
+    Elf64_Sym const* dynamic_symbols = (Elf64_Sym const*)(_file + dynamic_symbol_section->sh_offset);
+    std::size_t const dynamic_symbol_count = dynamic_symbol_section->sh_size / sizeof(Elf64_Sym);
+    Elf64_Shdr const& dynamic_string_section = sections[dynamic_symbol_section->sh_link];
+    char const* dynamic_strings = (char const*)(_file + dynamic_string_section.sh_offset);
+    for (uint16_t index = 0; index < header.e_shnum; ++index)
+    {
+        Elf64_Shdr const& section = sections[index];
+        if (section.sh_type != SHT_RELA || &sections[section.sh_link] != dynamic_symbol_section
+            || !InFile(section))
+            continue;
+
+        Elf64_Rela const* relocations = (Elf64_Rela const*)(_file + section.sh_offset);
+        std::size_t const relocation_count = section.sh_size / sizeof(Elf64_Rela);
+        for (std::size_t relocation_index = 0; relocation_index < relocation_count; ++relocation_index)
+        {
+            Elf64_Rela const& relocation = relocations[relocation_index];
+            uint32_t const type = (uint32_t)ELF64_R_TYPE(relocation.r_info);
+            uint64_t const symbol_index = ELF64_R_SYM(relocation.r_info);
+            if ((type != kGlobDatRelocation && type != kAbs64Relocation)
+                || symbol_index == 0 || symbol_index >= dynamic_symbol_count)
+                continue;
+
+            // Imports resolve to the same definition in every generation.
+            Elf64_Sym const& symbol = dynamic_symbols[symbol_index];
+            if (ELF64_ST_TYPE(symbol.st_info) != STT_OBJECT || symbol.st_shndx == SHN_UNDEF)
+                continue;
+
+            _image.data_references.push_back(DataReference{
+                _image.base + relocation.r_offset,
+                SymbolName(dynamic_strings, dynamic_string_section, symbol.st_name),
+                relocation.r_addend
+            });
+        }
+    }
+
+    return true;
+}
+
+static bool LoadPatchImage(std::string const& _loaded_path, uint32_t _generation, PatchImage& _image)
+{
+    _image = PatchImage{ _loaded_path, _generation, 0, 0, 0, {}, {}, {}, false, 0, 0 };
+    if (!PosixImageBase(_loaded_path, _image.base))
+    {
+        LoaderLog(bstk::kLogError, "{} isn't loaded", _loaded_path.c_str());
+        return false;
+    }
+
+    int const file = open(_loaded_path.c_str(), O_RDONLY);
+    struct stat file_stat{};
+    if (file < 0 || fstat(file, &file_stat) != 0 || file_stat.st_size <= 0)
+    {
+        LoaderLog(bstk::kLogError, "couldn't read {}", _loaded_path.c_str());
+        if (file >= 0)
+            close(file);
+        return false;
+    }
+
+    std::size_t const file_size = (std::size_t)file_stat.st_size;
+    void* const mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+    {
+        LoaderLog(bstk::kLogError, "couldn't map {}", _loaded_path.c_str());
+        return false;
+    }
+
+    bool const parsed = ElfReadImage((uint8_t const*)mapping, file_size, _image);
+    munmap(mapping, file_size);
+    if (!parsed)
+        LoaderLog(bstk::kLogError, "unsupported ELF image {}", _loaded_path.c_str());
+    return parsed;
+}
+
+// Encodes the shortest jump from _site to _target, returns its size.
+static std::size_t EncodeJump(uintptr_t _site, uintptr_t _target, uint8_t (&_bytes)[16])
+{
+#if defined(__x86_64__)
+    int64_t const displacement = (int64_t)_target - (int64_t)(_site + 5);
+    if (displacement >= INT32_MIN && displacement <= INT32_MAX)
+    {
+        // jmp rel32
+        int32_t const relative = (int32_t)displacement;
+        _bytes[0] = 0xe9;
+        std::memcpy(_bytes + 1, &relative, sizeof(relative));
+        return 5;
+    }
+
+    // jmp [rip+0] followed by the absolute address.
+    uint8_t const indirect[6] = { 0xff, 0x25, 0x00, 0x00, 0x00, 0x00 };
+    std::memcpy(_bytes, indirect, sizeof(indirect));
+    std::memcpy(_bytes + 6, &_target, sizeof(_target));
+    return 14;
+#else
+    int64_t const displacement = (int64_t)_target - (int64_t)_site;
+    if (displacement >= -(int64_t(1) << 27) && displacement < (int64_t(1) << 27))
+    {
+        // b imm26
+        uint32_t const instruction = 0x14000000u | ((uint32_t)(displacement >> 2) & 0x03ffffffu);
+        std::memcpy(_bytes, &instruction, sizeof(instruction));
+        return 4;
+    }
+
+    // ldr x16, #8 ; br x16 ; .quad target
+    uint32_t const instructions[2] = { 0x58000050u, 0xd61f0200u };
+    std::memcpy(_bytes, instructions, sizeof(instructions));
+    std::memcpy(_bytes + 8, &_target, sizeof(_target));
+    return 16;
+#endif
+}
+
+// Same code once linked at another address: equal bytes outside relocated fields, and
+// relocations to the same targets. Without relocations, only functions too small to hold a
+// displacement can be told apart from a layout shift, everything else counts as changed.
+static bool SameCode(PatchImage const& _old_image, ImageSymbol const& _old,
+                     PatchImage const& _new_image, ImageSymbol const& _new)
+{
+    if (_old.size != _new.size)
+        return false;
+    if (!_old_image.code_relocated || !_new_image.code_relocated)
+        return _new.size < kShortestJump && std::memcmp((void const*)_old.address, (void const*)_new.address, _new.size) == 0;
+
+    auto const Relocations = [](PatchImage const& _image, ImageSymbol const& _symbol) {
+        auto const ByAddress = [](CodeRelocation const& _relocation, uintptr_t _address) {
+            return _relocation.address < _address;
+        };
+        std::vector<CodeRelocation> const& all = _image.code_relocations;
+        return std::make_pair(std::lower_bound(all.begin(), all.end(), _symbol.address, ByAddress),
+                              std::lower_bound(all.begin(), all.end(), _symbol.address + _symbol.size, ByAddress));
+    };
+    auto [old_relocation, old_end] = Relocations(_old_image, _old);
+    auto [new_relocation, new_end] = Relocations(_new_image, _new);
+    if (old_end - old_relocation != new_end - new_relocation)
+        return false;
+
+    std::vector<uint8_t> old_code((uint8_t const*)_old.address, (uint8_t const*)(_old.address + _old.size));
+    std::vector<uint8_t> new_code((uint8_t const*)_new.address, (uint8_t const*)(_new.address + _new.size));
+    for (; old_relocation != old_end; ++old_relocation, ++new_relocation)
+    {
+        uintptr_t const offset = old_relocation->address - _old.address;
+        if (new_relocation->address - _new.address != offset
+            || new_relocation->type != old_relocation->type
+            || new_relocation->target != old_relocation->target
+            || new_relocation->addend != old_relocation->addend)
+            return false;
+
+        std::size_t const size = std::min<std::size_t>(old_relocation->size, _old.size - offset);
+        std::memset(old_code.data() + offset, 0, size);
+        std::memset(new_code.data() + offset, 0, size);
+    }
+    return old_code == new_code;
+}
+
+static std::vector<uintptr_t> TouchedPages(std::vector<PatchWrite> const& _writes)
+{
+    uintptr_t const page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    std::vector<uintptr_t> pages{};
+    for (PatchWrite const& write : _writes)
+    {
+        for (uintptr_t page = write.address & ~(page_size - 1); page < write.address + write.size; page += page_size)
+            pages.push_back(page);
+    }
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    return pages;
+}
+
+// Pointers are stored whole, threads reading them see the old or the new one.
+static void StoreData(PatchWrite const& _write)
+{
+    if (_write.size == sizeof(uint64_t) && (_write.address & (sizeof(uint64_t) - 1)) == 0)
+    {
+        uint64_t value = 0;
+        std::memcpy(&value, _write.bytes, sizeof(value));
+        __atomic_store_n((uint64_t*)_write.address, value, __ATOMIC_RELEASE);
+        return;
+    }
+    std::memcpy((void*)_write.address, _write.bytes, _write.size);
+}
+
+// Other threads may be entering the function: its first instruction becomes a jump to itself
+// while the rest is written, then the trampoline's first instruction replaces it in one store.
+// A thread already past the entry but inside the overwritten bytes isn't covered.
+static void StoreTrampoline(PatchWrite const& _write)
+{
+    char* const site = (char*)_write.address;
+#if defined(__x86_64__)
+    using Head = uint16_t;
+    Head const spin = 0xfeeb; // jmp .
+#else
+    using Head = uint32_t;
+    Head const spin = 0x14000000u; // b .
+#endif
+    Head head = 0;
+    std::memcpy(&head, _write.bytes, sizeof(head));
+
+    __atomic_store_n((Head*)site, spin, __ATOMIC_SEQ_CST);
+    __builtin___clear_cache(site, site + sizeof(head));
+    if (_write.size > sizeof(head))
+    {
+        std::memcpy(site + sizeof(head), _write.bytes + sizeof(head), _write.size - sizeof(head));
+        __builtin___clear_cache(site + sizeof(head), site + _write.size);
+    }
+    __atomic_store_n((Head*)site, head, __ATOMIC_SEQ_CST);
+    __builtin___clear_cache(site, site + sizeof(head));
+}
+
+// True when StoreTrampoline can replace the first instruction at _site in a single store.
+static bool AtomicEntry(uintptr_t _site)
+{
+#if defined(__x86_64__)
+    // Unaligned stores are only atomic within a cache line.
+    return (_site & 63) != 63;
+#else
+    return (_site & 3) == 0;
+#endif
+}
+
+// Applies every write or none, pages get _restored_protection back afterwards.
+static bool ApplyWrites(std::vector<PatchWrite> const& _writes, void (*_store)(PatchWrite const&),
+                        int _writable_protection, int (*_restored_protection)(uintptr_t, void const*),
+                        void const* _context)
+{
+    std::size_t const page_size = (std::size_t)sysconf(_SC_PAGESIZE);
+    std::vector<uintptr_t> const pages = TouchedPages(_writes);
+
+    for (std::size_t index = 0; index < pages.size(); ++index)
+    {
+        if (mprotect((void*)pages[index], page_size, _writable_protection) == 0)
+            continue;
+
+        LoaderLog(bstk::kLogError, "couldn't unprotect {} (errno {})", (void const*)pages[index], errno);
+        for (std::size_t restored = 0; restored < index; ++restored)
+            mprotect((void*)pages[restored], page_size, _restored_protection(pages[restored], _context));
+        return false;
+    }
+
+    for (PatchWrite const& write : _writes)
+        _store(write);
+
+    for (uintptr_t page : pages)
+        mprotect((void*)page, page_size, _restored_protection(page, _context));
+    return true;
+}
+
+static int CodeProtection(uintptr_t, void const*)
+{
+    return PROT_READ | PROT_EXEC;
+}
+
+// GOT entries are read-only once relocated (RELRO), absolute pointers live in writable data.
+// Like the dynamic loader, only pages entirely below the end of RELRO are protected.
+static int DataProtection(uintptr_t _page, void const* _context)
+{
+    PatchImage const& image = *(PatchImage const*)_context;
+    uintptr_t const page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    bool const relro = _page >= (image.relro_begin & ~(page_size - 1))
+        && _page + page_size <= image.relro_end;
+    return relro ? PROT_READ : PROT_READ | PROT_WRITE;
+}
+
+void ElfHotPatcher::OnLoad(std::string const& _loaded_path, uint32_t _generation)
+{
+    PatchImage image{};
+    if (!LoadPatchImage(_loaded_path, _generation, image))
+        return;
+
+    if (image.private_data_count > 0)
+    {
+        LoaderLog(bstk::kLogWarning, "{} module-local variables will start over on every patch,"
+                  " make them extern to keep them", image.private_data_count);
+    }
+    if (image.ambiguous_count > 0)
+    {
+        LoaderLog(bstk::kLogWarning, "{} symbols are defined more than once and won't be patched",
+                  image.ambiguous_count);
+    }
+    if (!image.code_relocated)
+    {
+        LoaderLog(bstk::kLogWarning, "{} has no code relocations, every function gets redirected on patch,"
+                  " link it with -Wl,--emit-relocs", _loaded_path.c_str());
+    }
+    images.push_back(std::move(image));
+}
+
+bool ElfHotPatcher::Patch(std::string const& _loaded_path, uint32_t _generation)
+{
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point const begin = Clock::now();
+
+    PatchImage image{};
+    if (!LoadPatchImage(_loaded_path, _generation, image))
+    {
+        images.clear();
+        history.push_back(PatchRecord{ _generation, false, 0, 0, 0, 0.0 });
+        return false;
+    }
+
+    PatchRecord record{ _generation, false, 0, 0, 0, 0.0 };
+    std::string failure = "";
+
+    // The context never reuses the copy of a generation that is still mapped, this only
+    // guards against a platform that does.
+    for (PatchImage const& live : images)
+    {
+        if (live.loaded_path == _loaded_path || live.base == image.base)
+            failure = "copy " + _loaded_path + " replaced a live generation";
+    }
+    if (images.empty())
+        failure = "no live generation";
+
+    std::vector<PatchWrite> data_writes{};
+    for (std::size_t index = 0; failure.empty() && index < image.data_references.size(); ++index)
+    {
+        DataReference const& reference = image.data_references[index];
+        auto const own = image.symbols.find(reference.name);
+        if (own == image.symbols.end() || own->second.function)
+            continue;
+
+        // The oldest definition holds the state, later generations were redirected to it.
+        for (PatchImage const& live : images)
+        {
+            auto const found = live.symbols.find(reference.name);
+            if (found == live.symbols.end() || found->second.function)
+                continue;
+
+            if (found->second.size != own->second.size)
+            {
+                failure = "layout of " + reference.name + " changed";
+                break;
+            }
+
+            uintptr_t const value = found->second.address + (uintptr_t)reference.addend;
+            PatchWrite write{ reference.slot, sizeof(value), {} };
+            std::memcpy(write.bytes, &value, sizeof(value));
+            data_writes.push_back(write);
+            ++record.redirected_references;
+            break;
+        }
+    }
+
+    std::vector<PatchWrite> code_writes{};
+    PatchImage const& latest = images.empty() ? image : images.back();
+    for (auto const& [key, symbol] : image.symbols)
+    {
+        if (!failure.empty())
+            break;
+        if (!symbol.function)
+            continue;
+
+        // New functions can only be reached through new code.
+        auto const previous = latest.symbols.find(key);
+        if (previous == latest.symbols.end() || !previous->second.function
+            || SameCode(latest, previous->second, image, symbol))
+            continue;
+
+        ++record.changed_functions;
+        for (PatchImage const& live : images)
+        {
+            auto const found = live.symbols.find(key);
+            if (found == live.symbols.end() || !found->second.function)
+                continue;
+
+            PatchWrite write{ found->second.address, 0, {} };
+            write.size = EncodeJump(write.address, symbol.address, write.bytes);
+            if (found->second.size < write.size)
+            {
+                failure = key + " is too small to patch";
+                break;
+            }
+            if (!AtomicEntry(write.address))
+            {
+                failure = "entry of " + key + " can't be patched atomically";
+                break;
+            }
+            code_writes.push_back(write);
+            ++record.patched_sites;
+        }
+    }
+
+    if (failure.empty() && !ApplyWrites(data_writes, StoreData, PROT_READ | PROT_WRITE, DataProtection, &image))
+        failure = "couldn't redirect data references";
+    // Data was already redirected to the live generation at this point, which is what a
+    // regular reload would have ended up with anyway.
+    if (failure.empty() && !ApplyWrites(code_writes, StoreTrampoline, PROT_READ | PROT_WRITE | PROT_EXEC, CodeProtection, nullptr))
+        failure = "couldn't write trampolines";
+
+    record.patched = failure.empty();
+    record.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    history.push_back(record);
+
+    if (!record.patched)
+    {
+        LoaderLog(bstk::kLogWarning, "generation {} not patched, {}, falling back to a regular reload",
+                  _generation, failure.c_str());
+        images.clear();
+        images.push_back(std::move(image));
+        return false;
+    }
+
+    LoaderLog(bstk::kLogInfo,
+              "patched generation {}: {} changed functions, {} trampolines, {} data references redirected in {}ms",
+              _generation, record.changed_functions, record.patched_sites, record.redirected_references,
+              record.milliseconds);
+    images.push_back(std::move(image));
+    return true;
+}
+
+void ElfHotPatcher::PrintReport() const
+{
+    if (history.empty())
+        return;
+
+    uint32_t patched_count = 0;
+    double patched_milliseconds = 0.0;
+    for (PatchRecord const& record : history)
+    {
+        if (!record.patched)
+            continue;
+        ++patched_count;
+        patched_milliseconds += record.milliseconds;
+    }
+
+    std::cout << "hot patching over " << history.size() << " reloads: "
+              << patched_count << " patched, " << history.size() - patched_count << " full reloads";
+    if (patched_count > 0)
+        std::cout << ", " << patched_milliseconds / patched_count << "ms per patch";
+    std::cout << std::endl;
+}
+
+std::unique_ptr<HotPatcher> CreateHotPatcher()
+{
+    return std::unique_ptr<HotPatcher>(new ElfHotPatcher());
+}
+
+#endif
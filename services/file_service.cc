@@ -0,0 +1,98 @@
+#include "file_service.hpp"
+#include "async_logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#if defined(__linux__)
+std::unique_ptr<FileService> CreateUringFileService();
+#endif
+
+bool SyncFileService::Submit(bstk::FileRequest* _request)
+{
+    // The size of an engine buffer is only known through the request.
+    if (_request->buffer && _request->size == 0)
+    {
+        _request->error = EINVAL;
+        _request->status = bstk::kFileFailed;
+        return false;
+    }
+
+    _request->status = bstk::kFilePending;
+    _request->error = 0;
+    _request->data = nullptr;
+    _request->bytes_read = 0;
+    queue.push_back(_request);
+    return true;
+}
+
+void SyncFileService::Release(bstk::FileRequest* _request)
+{
+    queue.erase(std::remove(queue.begin(), queue.end(), _request), queue.end());
+
+    if (!_request->buffer && _request->data)
+        std::free((void*)_request->data);
+    _request->data = nullptr;
+    _request->status = bstk::kFileIdle;
+}
+
+void SyncFileService::Update()
+{
+    for (bstk::FileRequest* request : queue)
+    {
+        FILE* file = std::fopen(request->path, "rb");
+        if (!file)
+        {
+            request->error = errno;
+            request->status = bstk::kFileFailed;
+            continue;
+        }
+
+        uint64_t size = request->size;
+        if (size == 0)
+        {
+            std::fseek(file, 0, SEEK_END);
+            long const end = std::ftell(file);
+            size = (end > (long)request->offset) ? (uint64_t)end - request->offset : 0u;
+        }
+
+        void* buffer = request->buffer ? request->buffer : std::malloc(size ? size : 1u);
+        std::fseek(file, (long)request->offset, SEEK_SET);
+        request->bytes_read = std::fread(buffer, 1, size, file);
+        request->data = buffer;
+        request->status = bstk::kFileDone;
+        std::fclose(file);
+    }
+
+    queue.clear();
+}
+
+std::unique_ptr<FileService> CreateFileService()
+{
+#if defined(__linux__)
+    if (std::unique_ptr<FileService> service = CreateUringFileService())
+        return service;
+    LoaderLog(bstk::kLogWarning, "io_uring unavailable, file reads will block");
+#endif
+    return std::unique_ptr<FileService>(new SyncFileService());
+}
+
+static bool HostReadFile(void* _service, bstk::FileRequest* _request)
+{
+    return ((FileService*)_service)->Submit(_request);
+}
+
+static void HostReleaseFile(void* _service, bstk::FileRequest* _request)
+{
+    ((FileService*)_service)->Release(_request);
+}
+
+void BindFileService(bstk::HostServices& _host, FileService* _service)
+{
+    _host.file_service = _service;
+    _host.ReadFile = HostReadFile;
+    _host.ReleaseFile = HostReleaseFile;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "loader/bstk.hpp"
+
+// Asynchronous file reads on behalf of engine modules.
+// Requests are queued by Submit and only handed to the OS in Update,
+// which the loader calls once per frame.
+struct FileService
+{
+    FileService() = default;
+    virtual ~FileService() = default;
+    FileService(FileService const&) = delete;
+    FileService& operator=(FileService const&) = delete;
+
+    virtual bool Submit(bstk::FileRequest* _request) = 0;
+    virtual void Release(bstk::FileRequest* _request) = 0;
+    virtual void Update() = 0;
+};
+
+// Blocking fallback, reads everything submitted during the frame in Update.
+struct SyncFileService : public FileService
+{
+    bool Submit(bstk::FileRequest* _request) override;
+    void Release(bstk::FileRequest* _request) override;
+    void Update() override;
+
+    std::vector<bstk::FileRequest*> queue = {};
+};
+
+// io_uring backed on Linux, falls back to SyncFileService when unavailable.
+std::unique_ptr<FileService> CreateFileService();
+
+void BindFileService(bstk::HostServices& _host, FileService* _service);
@@ -0,0 +1,165 @@
+#include "frame_stats.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <iostream>
+
+static constexpr uint32_t kExactBucketCount = 1u << LogHistogram::kSubBucketBits;
+static constexpr uint32_t kHalfBucketCount = kExactBucketCount >> 1;
+
+static uint32_t BucketIndex(uint64_t _value)
+{
+    constexpr uint64_t kMaxValue = (uint64_t(1) << LogHistogram::kMaxValueBits) - 1;
+    _value = std::min(_value, kMaxValue);
+
+    if (_value < kExactBucketCount)
+        return (uint32_t)_value;
+
+    uint32_t const msb = 63u - (uint32_t)std::countl_zero(_value);
+    uint32_t const shift = msb - LogHistogram::kSubBucketBits + 1u;
+    uint32_t const top = (uint32_t)(_value >> shift);
+    return kExactBucketCount + (shift - 1u) * kHalfBucketCount + (top - kHalfBucketCount);
+}
+
+// Highest value that maps to the bucket.
+static uint64_t BucketValue(uint32_t _index)
+{
+    if (_index < kExactBucketCount)
+        return _index;
+
+    uint32_t const shift = (_index - kExactBucketCount) / kHalfBucketCount + 1u;
+    uint64_t const top = (_index - kExactBucketCount) % kHalfBucketCount + kHalfBucketCount;
+    return ((top + 1u) << shift) - 1u;
+}
+
+void LogHistogram::Record(uint64_t _value)
+{
+    ++counts[BucketIndex(_value)];
+    ++sample_count;
+    max_value = std::max(max_value, _value);
+}
+
+uint64_t LogHistogram::ValueAtPercentile(double _percentile) const
+{
+    if (sample_count == 0)
+        return 0;
+
+    double const clamped = std::clamp(_percentile, 0.0, 100.0);
+    uint64_t const rank = std::max<uint64_t>(
+        1u, (uint64_t)((clamped / 100.0) * (double)sample_count + 0.5));
+
+    uint64_t accumulated = 0;
+    for (uint32_t index = 0; index < kBucketCount; ++index)
+    {
+        accumulated += counts[index];
+        if (accumulated >= rank)
+            return std::min(BucketValue(index), max_value);
+    }
+
+    return max_value;
+}
+
+void FrameStats::RecordPhase(eFramePhase _phase, uint64_t _duration_us, bool _reload)
+{
+    PhaseStats& stats = phases[_phase];
+    stats.histogram.Record(_duration_us);
+
+    if (_duration_us > hitch_threshold_us)
+    {
+        ++stats.hitch_count;
+        if (_reload)
+            ++stats.reload_hitch_count;
+    }
+}
+
+void FrameStats::RecordFrame(uint64_t _duration_us, bool _reload)
+{
+    RecordPhase(kFrame, _duration_us, _reload);
+
+    if (_duration_us > hitch_threshold_us)
+    {
+        hitch_log[hitch_log_head % kHitchLogSize] = Hitch{ frame_index, _duration_us, _reload };
+        ++hitch_log_head;
+    }
+
+    ++frame_index;
+}
+
+static char const* const kPhaseNames[kFramePhaseCount] = {
+    "frame",
+    "logic_update",
+    "draw_frame"
+};
+
+void FrameStats::WriteReport(std::ostream& _stream) const
+{
+    _stream << "frame stats over " << frame_index << " frames"
+            << " (hitch threshold " << hitch_threshold_us << "us)" << "\n";
+
+    for (uint32_t phase = 0; phase < kFramePhaseCount; ++phase)
+    {
+        PhaseStats const& stats = phases[phase];
+        _stream << "\t" << kPhaseNames[phase]
+                << " p50 " << stats.histogram.ValueAtPercentile(50.0) << "us"
+                << " p99 " << stats.histogram.ValueAtPercentile(99.0) << "us"
+                << " p99.9 " << stats.histogram.ValueAtPercentile(99.9) << "us"
+                << " max " << stats.histogram.max_value << "us"
+                << " hitches " << stats.hitch_count
+                << " (" << stats.reload_hitch_count << " on reload)"
+                << "\n";
+    }
+
+    uint64_t const logged = std::min<uint64_t>(hitch_log_head, kHitchLogSize);
+    for (uint64_t index = hitch_log_head - logged; index < hitch_log_head; ++index)
+    {
+        Hitch const& hitch = hitch_log[index % kHitchLogSize];
+        _stream << "\thitch frame " << hitch.frame_index
+                << " " << hitch.duration_us << "us"
+                << (hitch.reload ? " [reload]" : "")
+                << "\n";
+    }
+}
+
+void FrameStats::PrintReport() const
+{
+    WriteReport(std::cout);
+    std::cout.flush();
+}
+
+bool FrameStats::WriteCSV(std::string const& _path) const
+{
+    std::ofstream file(_path);
+    if (!file)
+    {
+        std::cout << "[ERROR] couldn't open " << _path << std::endl;
+        return false;
+    }
+
+    file << "phase,samples,p50_us,p99_us,p99_9_us,max_us,hitches,reload_hitches\n";
+    for (uint32_t phase = 0; phase < kFramePhaseCount; ++phase)
+    {
+        PhaseStats const& stats = phases[phase];
+        file << kPhaseNames[phase] << ","
+             << stats.histogram.sample_count << ","
+             << stats.histogram.ValueAtPercentile(50.0) << ","
+             << stats.histogram.ValueAtPercentile(99.0) << ","
+             << stats.histogram.ValueAtPercentile(99.9) << ","
+             << stats.histogram.max_value << ","
+             << stats.hitch_count << ","
+             << stats.reload_hitch_count << "\n";
+    }
+
+    // Same hitches as the text report, each attributed to a reload or not.
+    file << "\nhitch_frame,duration_us,reload\n";
+    uint64_t const logged = std::min<uint64_t>(hitch_log_head, kHitchLogSize);
+    for (uint64_t index = hitch_log_head - logged; index < hitch_log_head; ++index)
+    {
+        Hitch const& hitch = hitch_log[index % kHitchLogSize];
+        file << hitch.frame_index << ","
+             << hitch.duration_us << ","
+             << (hitch.reload ? 1 : 0) << "\n";
+    }
+
+    return (bool)file;
+}
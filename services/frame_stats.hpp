@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Log-bucketed histogram with fixed storage (HDR-style).
+// Values below 2^kSubBucketBits are stored exactly, larger values keep
+// kSubBucketBits-1 bits of precision (~3% relative error).
+struct LogHistogram
+{
+    static constexpr uint32_t kSubBucketBits = 6;
+    static constexpr uint32_t kMaxValueBits = 40;
+    static constexpr uint32_t kBucketCount =
+        (1u << kSubBucketBits) + (kMaxValueBits - kSubBucketBits + 1) * (1u << (kSubBucketBits - 1));
+
+    void Record(uint64_t _value);
+    uint64_t ValueAtPercentile(double _percentile) const;
+
+    std::array<uint32_t, kBucketCount> counts = {};
+    uint64_t sample_count = 0;
+    uint64_t max_value = 0;
+};
+
+enum eFramePhase
+{
+    kFrame = 0u,
+    kLogicUpdate,
+    kDrawFrame,
+    kFramePhaseCount
+};
+
+struct FrameStats
+{
+    static constexpr uint32_t kHitchLogSize = 256;
+
+    struct Hitch
+    {
+        uint64_t frame_index;
+        uint64_t duration_us;
+        bool reload;
+    };
+
+    struct PhaseStats
+    {
+        LogHistogram histogram;
+        uint64_t hitch_count = 0;
+        uint64_t reload_hitch_count = 0;
+    };
+
+    explicit FrameStats(uint64_t _hitch_threshold_us) : hitch_threshold_us{ _hitch_threshold_us } {}
+
+    void RecordPhase(eFramePhase _phase, uint64_t _duration_us, bool _reload);
+    // Records the whole frame and advances the frame counter.
+    void RecordFrame(uint64_t _duration_us, bool _reload);
+
+    void WriteReport(std::ostream& _stream) const;
+    void PrintReport() const;
+    // Per phase table, then after a blank line one row per logged hitch with its reload flag.
+    bool WriteCSV(std::string const& _path) const;
+
+    uint64_t hitch_threshold_us;
+    uint64_t frame_index = 0;
+    std::array<PhaseStats, kFramePhaseCount> phases = {};
+
+    // Ring of the most recent frame hitches.
+    std::array<Hitch, kHitchLogSize> hitch_log = {};
+    uint64_t hitch_log_head = 0;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Patches a freshly loaded generation into the live one instead of swapping modules.
+// Functions whose code differs from the live generation get a jump to their new version
+// written over their entry in every generation loaded so far, so that pointers the engine
+// stored (callbacks, vtables) reach the new code. Code is compared through the link time
+// relocations kept by -Wl,--emit-relocs, without them every function counts as changed.
+// Threads entering a function while it is patched wait at its entry, engine threads must not
+// be suspended inside a function's first instructions during a reload. The new generation's references to
+// exported data are pointed back at the first generation that defined it, keeping state.
+// Module-local variables (static, hidden) can't be redirected and start over in each build.
+// Patched generations must stay mapped until exit.
+struct HotPatcher
+{
+    HotPatcher() = default;
+    virtual ~HotPatcher() = default;
+    HotPatcher(HotPatcher const&) = delete;
+    HotPatcher& operator=(HotPatcher const&) = delete;
+
+    // Registers the generation loaded at startup.
+    virtual void OnLoad(std::string const& _loaded_path, uint32_t _generation)
+    { (void)_loaded_path; (void)_generation; }
+    // Must run before any code of the new generation is called. Returns false when the new
+    // generation couldn't be patched in, it then behaves as a regular reload and becomes
+    // the base for the next patches.
+    virtual bool Patch(std::string const& _loaded_path, uint32_t _generation)
+    { (void)_loaded_path; (void)_generation; return false; }
+    virtual void PrintReport() const {}
+};
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+std::unique_ptr<HotPatcher> CreateHotPatcher();
+#else
+// Trampolines are only implemented for ELF on x86-64 and AArch64.
+inline std::unique_ptr<HotPatcher> CreateHotPatcher()
+{
+    return nullptr;
+}
+#endif
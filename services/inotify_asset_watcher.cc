@@ -0,0 +1,175 @@
+#include "asset_watcher.hpp"
+#include "async_logger.hpp"
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <iostream>
+#include <unordered_map>
+
+static constexpr uint32_t kDirectoryMask =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+
+struct InotifyAssetWatcher : public AssetWatcher
+{
+    ~InotifyAssetWatcher() override;
+
+    bool Watch(std::string const& _directory) override;
+    void PollEvents() override;
+
+    // Adds a watch on every directory below _directory, reporting files found when _notify is set.
+    // False when _directory itself can't be watched, subdirectories are only warned about.
+    bool WatchTree(std::string const& _directory, bool _notify, Clock::time_point _now);
+    // Drops the watches on _directory and below, their paths are gone.
+    void UnwatchTree(std::string const& _directory);
+
+    int inotify_fd = -1;
+    std::unordered_map<int, std::string> watched_directories = {};
+};
+
+InotifyAssetWatcher::~InotifyAssetWatcher()
+{
+    if (inotify_fd >= 0)
+        close(inotify_fd);
+}
+
+bool InotifyAssetWatcher::WatchTree(std::string const& _directory, bool _notify, Clock::time_point _now)
+{
+    int const wd = inotify_add_watch(inotify_fd, _directory.c_str(), kDirectoryMask);
+    if (wd < 0)
+    {
+        LoaderLog(bstk::kLogWarning, "couldn't watch {} (errno {})", _directory.c_str(), errno);
+        return false;
+    }
+    watched_directories[wd] = _directory;
+
+    DIR* dir = opendir(_directory.c_str());
+    if (!dir)
+        return true;
+
+    while (dirent* entry = readdir(dir))
+    {
+        std::string const name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+
+        std::string const path = _directory + "/" + name;
+        bool is_directory = (entry->d_type == DT_DIR);
+        if (entry->d_type == DT_UNKNOWN)
+        {
+            struct stat file_stat;
+            is_directory = (lstat(path.c_str(), &file_stat) == 0) && S_ISDIR(file_stat.st_mode);
+        }
+
+        if (is_directory)
+            WatchTree(path, _notify, _now);
+        else if (_notify)
+            Notify(path, _now);
+    }
+
+    closedir(dir);
+    return true;
+}
+
+void InotifyAssetWatcher::UnwatchTree(std::string const& _directory)
+{
+    std::string const prefix = _directory + "/";
+    for (auto watched = watched_directories.begin(); watched != watched_directories.end();)
+    {
+        if (watched->second != _directory && watched->second.compare(0, prefix.size(), prefix) != 0)
+        {
+            ++watched;
+            continue;
+        }
+        // The IN_IGNORED that follows finds no mapping anymore.
+        inotify_rm_watch(inotify_fd, watched->first);
+        watched = watched_directories.erase(watched);
+    }
+}
+
+bool InotifyAssetWatcher::Watch(std::string const& _directory)
+{
+    std::string directory = _directory;
+    while (directory.size() > 1 && directory.back() == '/')
+        directory.pop_back();
+
+    for (auto const& watched : watched_directories)
+    {
+        if (watched.second == directory)
+            return true;
+    }
+
+    return WatchTree(directory, false, Clock::now());
+}
+
+void InotifyAssetWatcher::PollEvents()
+{
+    alignas(inotify_event) char buffer[4096];
+    Clock::time_point const now = Clock::now();
+
+    for (;;)
+    {
+        ssize_t const size = read(inotify_fd, buffer, sizeof(buffer));
+        if (size <= 0)
+            break;
+
+        for (char const* cursor = buffer; cursor < buffer + size;)
+        {
+            inotify_event const& event = *(inotify_event const*)cursor;
+            cursor += sizeof(inotify_event) + event.len;
+
+            if (event.mask & IN_Q_OVERFLOW)
+            {
+                LoaderLog(bstk::kLogWarning, "asset watcher queue overflow, changes were lost");
+                continue;
+            }
+
+            auto directory = watched_directories.find(event.wd);
+            if (directory == watched_directories.end())
+                continue;
+
+            if (event.mask & IN_IGNORED)
+            {
+                watched_directories.erase(directory);
+                continue;
+            }
+
+            if (event.len == 0)
+                continue;
+
+            std::string const path = directory->second + "/" + event.name;
+            if (event.mask & IN_ISDIR)
+            {
+                // A directory moved or created in place may already hold files.
+                if (event.mask & (IN_CREATE | IN_MOVED_TO))
+                    WatchTree(path, true, now);
+                // Watches follow the directory, they would keep reporting under the old path. A
+                // rename within the tree is watched again by its IN_MOVED_TO.
+                if (event.mask & IN_MOVED_FROM)
+                {
+                    UnwatchTree(path);
+                    Notify(path, now);
+                }
+                continue;
+            }
+
+            // Plain creation is followed by IN_CLOSE_WRITE once the content is there.
+            if (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE))
+                Notify(path, now);
+        }
+    }
+}
+
+std::unique_ptr<AssetWatcher> CreateInotifyAssetWatcher()
+{
+    int const fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    std::unique_ptr<InotifyAssetWatcher> watcher{ new InotifyAssetWatcher() };
+    watcher->inotify_fd = fd;
+    return watcher;
+}
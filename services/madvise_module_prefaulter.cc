@@ -0,0 +1,203 @@
+#include "module_prefaulter.hpp"
+#include "async_logger.hpp"
+
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+struct SegmentRange
+{
+    uintptr_t begin;
+    uintptr_t end;
+    bool writable;
+};
+
+struct FirstFrame
+{
+    uint32_t generation;
+    uint64_t prefaulted_bytes;
+    uint64_t prefault_us;
+    uint64_t minor_faults;
+    uint64_t major_faults;
+    uint64_t frame_us;
+};
+
+struct MadviseModulePrefaulter : public ModulePrefaulter
+{
+    explicit MadviseModulePrefaulter(bool _prefault) : prefault{ _prefault } {}
+
+    void Prefault(std::string const& _loaded_path, uint32_t _generation) override;
+    void BeginFrame() override;
+    void EndFrame(uint64_t _frame_us) override;
+    void PrintReport() const override;
+
+    bool prefault;
+    bool first_frame_pending = false;
+    FirstFrame pending = {};
+    rusage frame_begin = {};
+    std::vector<FirstFrame> first_frames = {};
+
+    uint64_t steady_frame_count = 0;
+    uint64_t steady_minor_faults = 0;
+    uint64_t steady_major_faults = 0;
+    uint64_t steady_frame_us = 0;
+};
+
+struct SegmentQuery
+{
+    std::string const* loaded_path;
+    std::vector<SegmentRange>* segments;
+};
+
+static int PhdrCallback(dl_phdr_info* _info, size_t, void* _data)
+{
+    SegmentQuery& query = *(SegmentQuery*)_data;
+    if (!_info->dlpi_name || *query.loaded_path != _info->dlpi_name)
+        return 0;
+
+    uintptr_t const page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+
+    // The dynamic loader makes the pages below the end of RELRO read-only.
+    uintptr_t relro_end = 0;
+    for (ElfW(Half) index = 0; index < _info->dlpi_phnum; ++index)
+    {
+        ElfW(Phdr) const& header = _info->dlpi_phdr[index];
+        if (header.p_type == PT_GNU_RELRO)
+            relro_end = (_info->dlpi_addr + header.p_vaddr + header.p_memsz) & ~(page_size - 1);
+    }
+
+    for (ElfW(Half) index = 0; index < _info->dlpi_phnum; ++index)
+    {
+        ElfW(Phdr) const& header = _info->dlpi_phdr[index];
+        if (header.p_type != PT_LOAD || header.p_memsz == 0)
+            continue;
+
+        uintptr_t const begin = (_info->dlpi_addr + header.p_vaddr) & ~(page_size - 1);
+        uintptr_t const end = (_info->dlpi_addr + header.p_vaddr + header.p_memsz + page_size - 1) & ~(page_size - 1);
+        bool const writable = (header.p_flags & PF_W) != 0;
+
+        if (writable && relro_end > begin && relro_end < end)
+        {
+            query.segments->push_back(SegmentRange{ begin, relro_end, false });
+            query.segments->push_back(SegmentRange{ relro_end, end, true });
+        }
+        else
+        {
+            query.segments->push_back(SegmentRange{ begin, end, writable && relro_end < end });
+        }
+    }
+    return 1;
+}
+
+// Faults every page of the range in, without the readahead round trips of lazy faulting.
+static void PrefaultRange(SegmentRange const& _range)
+{
+    void* const begin = (void*)_range.begin;
+    std::size_t const size = _range.end - _range.begin;
+    madvise(begin, size, MADV_WILLNEED);
+
+#if defined(MADV_POPULATE_READ)
+    // Writable pages also get their private copies made up front.
+    if (_range.writable && madvise(begin, size, MADV_POPULATE_WRITE) == 0)
+        return;
+    if (madvise(begin, size, MADV_POPULATE_READ) == 0)
+        return;
+#endif
+
+    // Older kernels, touching one byte per page has the same effect for reads.
+    uintptr_t const page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    for (uintptr_t page = _range.begin; page < _range.end; page += page_size)
+        (void)*(uint8_t const volatile*)page;
+}
+
+void MadviseModulePrefaulter::Prefault(std::string const& _loaded_path, uint32_t _generation)
+{
+    pending = FirstFrame{ _generation, 0, 0, 0, 0, 0 };
+    first_frame_pending = true;
+    if (!prefault)
+        return;
+
+    std::vector<SegmentRange> segments{};
+    SegmentQuery query{ &_loaded_path, &segments };
+    dl_iterate_phdr(PhdrCallback, &query);
+    if (segments.empty())
+    {
+        LoaderLog(bstk::kLogWarning, "couldn't find the segments of {}", _loaded_path.c_str());
+        return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point const begin = Clock::now();
+    for (SegmentRange const& segment : segments)
+    {
+        PrefaultRange(segment);
+        pending.prefaulted_bytes += segment.end - segment.begin;
+    }
+    pending.prefault_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - begin).count();
+}
+
+void MadviseModulePrefaulter::BeginFrame()
+{
+    // Frame thread only, workers, the logger and builds fault concurrently.
+    getrusage(RUSAGE_THREAD, &frame_begin);
+}
+
+void MadviseModulePrefaulter::EndFrame(uint64_t _frame_us)
+{
+    rusage frame_end{};
+    getrusage(RUSAGE_THREAD, &frame_end);
+    uint64_t const minor_faults = (uint64_t)(frame_end.ru_minflt - frame_begin.ru_minflt);
+    uint64_t const major_faults = (uint64_t)(frame_end.ru_majflt - frame_begin.ru_majflt);
+
+    if (first_frame_pending)
+    {
+        pending.minor_faults = minor_faults;
+        pending.major_faults = major_faults;
+        pending.frame_us = _frame_us;
+        first_frames.push_back(pending);
+        first_frame_pending = false;
+        return;
+    }
+
+    ++steady_frame_count;
+    steady_minor_faults += minor_faults;
+    steady_major_faults += major_faults;
+    steady_frame_us += _frame_us;
+}
+
+void MadviseModulePrefaulter::PrintReport() const
+{
+    if (first_frames.empty())
+        return;
+
+    std::cout << "first frame per generation (prefault " << (prefault ? "on" : "off") << ")";
+    if (steady_frame_count > 0)
+    {
+        std::cout << ", steady state "
+                  << (double)steady_minor_faults / (double)steady_frame_count << " minor "
+                  << (double)steady_major_faults / (double)steady_frame_count << " major faults "
+                  << steady_frame_us / steady_frame_count << "us per frame";
+    }
+    std::cout << std::endl;
+
+    for (FirstFrame const& frame : first_frames)
+    {
+        std::cout << "\tgeneration " << frame.generation;
+        if (prefault)
+            std::cout << " prefault " << (frame.prefaulted_bytes >> 10) << "KB in " << frame.prefault_us << "us,";
+        std::cout << " first frame " << frame.frame_us << "us "
+                  << frame.minor_faults << " minor " << frame.major_faults << " major faults"
+                  << std::endl;
+    }
+}
+
+std::unique_ptr<ModulePrefaulter> CreateMadviseModulePrefaulter(bool _prefault)
+{
+    return std::unique_ptr<ModulePrefaulter>(new MadviseModulePrefaulter(_prefault));
+}
@@ -0,0 +1,14 @@
+#include "module_memory.hpp"
+
+#if defined(__linux__)
+std::unique_ptr<ModuleMemoryTracker> CreateProcModuleMemoryTracker();
+#endif
+
+std::unique_ptr<ModuleMemoryTracker> CreateModuleMemoryTracker()
+{
+#if defined(__linux__)
+    return CreateProcModuleMemoryTracker();
+#else
+    return std::unique_ptr<ModuleMemoryTracker>(new ModuleMemoryTracker());
+#endif
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Accounts the memory held by each module generation, checks that generations really
+// go away once released and tracks process growth across a reload session.
+struct ModuleMemoryTracker
+{
+    ModuleMemoryTracker() = default;
+    virtual ~ModuleMemoryTracker() = default;
+    ModuleMemoryTracker(ModuleMemoryTracker const&) = delete;
+    ModuleMemoryTracker& operator=(ModuleMemoryTracker const&) = delete;
+
+    virtual void OnLoad(std::string const& _loaded_path, uint32_t _generation)
+    { (void)_loaded_path; (void)_generation; }
+    // Called once the generation's platform data has been released.
+    virtual void OnUnload(std::string const& _loaded_path, uint32_t _generation)
+    { (void)_loaded_path; (void)_generation; }
+    virtual void PrintReport() const {}
+};
+
+// /proc and dl_iterate_phdr based on Linux, does nothing elsewhere.
+std::unique_ptr<ModuleMemoryTracker> CreateModuleMemoryTracker();
@@ -0,0 +1,15 @@
+#include "module_prefaulter.hpp"
+
+#if defined(__linux__)
+std::unique_ptr<ModulePrefaulter> CreateMadviseModulePrefaulter(bool _prefault);
+#endif
+
+std::unique_ptr<ModulePrefaulter> CreateModulePrefaulter(bool _prefault)
+{
+#if defined(__linux__)
+    return CreateMadviseModulePrefaulter(_prefault);
+#else
+    (void)_prefault;
+    return std::unique_ptr<ModulePrefaulter>(new ModulePrefaulter());
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Faults a freshly loaded generation's segments in before its first frame instead of
+// letting the frame take the page faults, and measures what is left of the reload hitch:
+// page faults and duration of the first frame of every generation against steady state.
+struct ModulePrefaulter
+{
+    ModulePrefaulter() = default;
+    virtual ~ModulePrefaulter() = default;
+    ModulePrefaulter(ModulePrefaulter const&) = delete;
+    ModulePrefaulter& operator=(ModulePrefaulter const&) = delete;
+
+    // Also marks the next frame as the generation's first one.
+    virtual void Prefault(std::string const& _loaded_path, uint32_t _generation)
+    { (void)_loaded_path; (void)_generation; }
+    // Brackets the engine's part of a frame.
+    virtual void BeginFrame() {}
+    virtual void EndFrame(uint64_t _frame_us) { (void)_frame_us; }
+    virtual void PrintReport() const {}
+};
+
+// madvise based on Linux, does nothing elsewhere. Without _prefault, only measures.
+std::unique_ptr<ModulePrefaulter> CreateModulePrefaulter(bool _prefault);
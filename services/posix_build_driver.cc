@@ -0,0 +1,95 @@
+#include "build_driver.hpp"
+#include "async_logger.hpp"
+#include "thread_tuning.hpp"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+extern char** environ;
+
+struct PosixBuildDriver : public BuildDriver
+{
+    using BuildDriver::BuildDriver;
+    ~PosixBuildDriver() override;
+
+    bool SpawnBuild() override;
+    void CancelBuild() override;
+    bool PollBuild(bool& _success) override;
+
+    pid_t build_pid = -1;
+};
+
+PosixBuildDriver::~PosixBuildDriver()
+{
+    if (build_pid < 0)
+        return;
+
+    kill(-build_pid, SIGTERM);
+    int status = 0;
+    waitpid(build_pid, &status, 0);
+}
+
+bool PosixBuildDriver::SpawnBuild()
+{
+    // Everything the child needs is prepared here, it only makes async-signal-safe calls.
+    char const* argv[] = { "sh", "-c", command.c_str(), nullptr };
+    sched_param const default_parameters{};
+    sigset_t no_signals;
+    sigemptyset(&no_signals);
+
+    pid_t const pid = fork();
+    if (pid == 0)
+    {
+        // Own process group so that cancelling also reaches the compilers spawned by the build.
+        // Scheduling is set before exec, never patched up once the build already runs.
+        setpgid(0, 0);
+        sched_setscheduler(0, SCHED_OTHER, &default_parameters);
+        if (thread_tuning)
+            thread_tuning->ConfigureChildProcess();
+        sigprocmask(SIG_SETMASK, &no_signals, nullptr);
+        execve("/bin/sh", (char* const*)argv, environ);
+        _exit(127);
+    }
+
+    if (pid < 0)
+    {
+        LoaderLog(bstk::kLogError, "couldn't start build (errno {})", errno);
+        return false;
+    }
+
+    // Also from the parent, a CancelBuild right away must not race the child's setpgid.
+    setpgid(pid, pid);
+    build_pid = pid;
+    return true;
+}
+
+void PosixBuildDriver::CancelBuild()
+{
+    if (build_pid < 0)
+        return;
+
+    // Reaped by PollBuild, the frame thread never waits for the whole group to exit.
+    kill(-build_pid, SIGTERM);
+}
+
+bool PosixBuildDriver::PollBuild(bool& _success)
+{
+    int status = 0;
+    if (build_pid < 0 || waitpid(build_pid, &status, WNOHANG) != build_pid)
+        return false;
+
+    build_pid = -1;
+    _success = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return true;
+}
+
+std::unique_ptr<BuildDriver> CreatePosixBuildDriver(std::string const& _command,
+                                                    std::unique_ptr<AssetWatcher> _watcher)
+{
+    return std::unique_ptr<BuildDriver>(new PosixBuildDriver(_command, std::move(_watcher)));
+}
@@ -0,0 +1,251 @@
+#include "module_memory.hpp"
+#include "async_logger.hpp"
+
+#include <elf.h>
+#include <link.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+struct GenerationMemory
+{
+    std::string loaded_path;
+    std::string real_path;
+    uint32_t generation;
+
+    uint64_t image_bytes;
+    uint64_t tls_bytes;
+    uint64_t mapped_bytes;
+    uint64_t rss_bytes;
+
+    uint64_t process_rss;
+    uint64_t heap_bytes;
+
+    bool released;
+    bool unloaded;
+    uint64_t leftover_bytes;
+};
+
+struct MappingUsage
+{
+    uint64_t mapped_bytes;
+    uint64_t rss_bytes;
+};
+
+struct ImageUsage
+{
+    bool found;
+    uint64_t image_bytes;
+    uint64_t tls_bytes;
+};
+
+struct ProcModuleMemoryTracker : public ModuleMemoryTracker
+{
+    void OnLoad(std::string const& _loaded_path, uint32_t _generation) override;
+    void OnUnload(std::string const& _loaded_path, uint32_t _generation) override;
+    void PrintReport() const override;
+
+    std::vector<GenerationMemory> generations = {};
+};
+
+// Sums smaps Size/Rss over every mapping of _real_path.
+static MappingUsage SmapsUsage(std::string const& _real_path)
+{
+    MappingUsage usage{ 0, 0 };
+
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool matching = false;
+
+    while (std::getline(smaps, line))
+    {
+        std::istringstream fields(line);
+        std::string first;
+        fields >> first;
+
+        // Mapping headers start with the address range, entries with "Name:".
+        if (!first.empty() && first.back() != ':')
+        {
+            std::string permissions, offset, device, inode, path;
+            fields >> permissions >> offset >> device >> inode;
+            std::getline(fields >> std::ws, path);
+            if (path.size() > 10 && path.compare(path.size() - 10, 10, " (deleted)") == 0)
+                path.resize(path.size() - 10);
+            matching = (path == _real_path);
+            continue;
+        }
+
+        if (!matching)
+            continue;
+
+        uint64_t kilobytes = 0;
+        fields >> kilobytes;
+        if (first == "Size:")
+            usage.mapped_bytes += kilobytes << 10;
+        else if (first == "Rss:")
+            usage.rss_bytes += kilobytes << 10;
+    }
+
+    return usage;
+}
+
+struct PhdrQuery
+{
+    std::string const* loaded_path;
+    std::string const* real_path;
+    ImageUsage usage;
+};
+
+static int PhdrCallback(dl_phdr_info* _info, size_t, void* _data)
+{
+    PhdrQuery& query = *(PhdrQuery*)_data;
+    if (!_info->dlpi_name
+        || (*query.loaded_path != _info->dlpi_name && *query.real_path != _info->dlpi_name))
+        return 0;
+
+    query.usage.found = true;
+    for (ElfW(Half) index = 0; index < _info->dlpi_phnum; ++index)
+    {
+        ElfW(Phdr) const& header = _info->dlpi_phdr[index];
+        if (header.p_type == PT_LOAD)
+            query.usage.image_bytes += header.p_memsz;
+        else if (header.p_type == PT_TLS)
+            query.usage.tls_bytes += header.p_memsz;
+    }
+    return 1;
+}
+
+static ImageUsage LoadedImageUsage(std::string const& _loaded_path, std::string const& _real_path)
+{
+    PhdrQuery query{ &_loaded_path, &_real_path, ImageUsage{ false, 0, 0 } };
+    dl_iterate_phdr(PhdrCallback, &query);
+    return query.usage;
+}
+
+static uint64_t ProcessRss()
+{
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size_pages = 0, resident_pages = 0;
+    statm >> size_pages >> resident_pages;
+    return resident_pages * (uint64_t)sysconf(_SC_PAGESIZE);
+}
+
+static uint64_t HeapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return (uint64_t)mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+static uint64_t Kilobytes(uint64_t _bytes)
+{
+    return _bytes >> 10;
+}
+
+void ProcModuleMemoryTracker::OnLoad(std::string const& _loaded_path, uint32_t _generation)
+{
+    char resolved[PATH_MAX];
+    std::string const real_path = realpath(_loaded_path.c_str(), resolved) ? resolved : _loaded_path;
+
+    MappingUsage const mapping = SmapsUsage(real_path);
+    ImageUsage const image = LoadedImageUsage(_loaded_path, real_path);
+
+    generations.push_back(GenerationMemory{
+        _loaded_path,
+        real_path,
+        _generation,
+        image.image_bytes,
+        image.tls_bytes,
+        mapping.mapped_bytes,
+        mapping.rss_bytes,
+        ProcessRss(),
+        HeapInUse(),
+        false,
+        false,
+        0
+    });
+}
+
+void ProcModuleMemoryTracker::OnUnload(std::string const& _loaded_path, uint32_t _generation)
+{
+    for (GenerationMemory& memory : generations)
+    {
+        if (memory.generation != _generation || memory.loaded_path != _loaded_path)
+            continue;
+
+        memory.released = true;
+
+        ImageUsage const image = LoadedImageUsage(memory.loaded_path, memory.real_path);
+        MappingUsage const mapping = SmapsUsage(memory.real_path);
+        memory.unloaded = !image.found && mapping.mapped_bytes == 0;
+        memory.leftover_bytes = mapping.mapped_bytes;
+
+        if (!memory.unloaded)
+        {
+            // Typical culprits are STB_GNU_UNIQUE symbols (inline statics, typeinfo)
+            // and thread_local objects with destructors, both pin the library.
+            LoaderLog(bstk::kLogWarning, "generation {} ({}) is still mapped after release, {}KB{}",
+                      _generation, _loaded_path.c_str(), Kilobytes(mapping.mapped_bytes),
+                      image.found ? ", still registered with the dynamic loader" : "");
+        }
+        return;
+    }
+}
+
+void ProcModuleMemoryTracker::PrintReport() const
+{
+    // Nothing interesting without reloads.
+    if (generations.size() < 2)
+        return;
+
+    std::cout << "module memory over " << generations.size() << " generations" << std::endl;
+
+    uint32_t pinned_count = 0;
+    uint64_t pinned_bytes = 0;
+    for (GenerationMemory const& memory : generations)
+    {
+        std::cout << "\tgeneration " << memory.generation
+                  << " image " << Kilobytes(memory.image_bytes) << "KB"
+                  << " mapped " << Kilobytes(memory.mapped_bytes) << "KB"
+                  << " rss " << Kilobytes(memory.rss_bytes) << "KB"
+                  << " tls " << memory.tls_bytes << "B"
+                  << (!memory.released ? " [live]" : memory.unloaded ? " [unloaded]" : " [pinned]")
+                  << std::endl;
+
+        if (memory.released && !memory.unloaded)
+        {
+            ++pinned_count;
+            pinned_bytes += memory.leftover_bytes;
+        }
+    }
+
+    GenerationMemory const& first = generations.front();
+    uint64_t const rss = ProcessRss();
+    uint64_t const heap = HeapInUse();
+    uint64_t const reloads = generations.size() - 1;
+
+    std::cout << "\tpinned generations " << pinned_count << " (" << Kilobytes(pinned_bytes) << "KB)"
+              << std::endl
+              << "\tprocess rss " << Kilobytes(first.process_rss) << "KB -> " << Kilobytes(rss) << "KB"
+              << ", heap " << Kilobytes(first.heap_bytes) << "KB -> " << Kilobytes(heap) << "KB";
+    if (reloads > 0)
+    {
+        std::cout << " (" << ((int64_t)rss - (int64_t)first.process_rss) / (int64_t)reloads / 1024
+                  << "KB rss per reload)";
+    }
+    std::cout << std::endl;
+}
+
+std::unique_ptr<ModuleMemoryTracker> CreateProcModuleMemoryTracker()
+{
+    return std::unique_ptr<ModuleMemoryTracker>(new ProcModuleMemoryTracker());
+}
@@ -0,0 +1,16 @@
+#include "sampling_profiler.hpp"
+
+#if defined(__linux__)
+std::unique_ptr<SamplingProfiler> CreateSigprofProfiler(uint32_t _frequency);
+#endif
+
+std::unique_ptr<SamplingProfiler> CreateSamplingProfiler(uint32_t _frequency)
+{
+#if defined(__linux__)
+    if (std::unique_ptr<SamplingProfiler> profiler = CreateSigprofProfiler(_frequency))
+        return profiler;
+#else
+    (void)_frequency;
+#endif
+    return std::unique_ptr<SamplingProfiler>(new SamplingProfiler());
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Samples the frame thread's call stack at a fixed rate and aggregates folded stacks
+// (flamegraph.pl / speedscope input). Frames inside a module copy are reported under the
+// module's logical name and reload generation rather than the <module>_N file name.
+// Samples must be drained before a generation gets unloaded, symbols are resolved there.
+struct SamplingProfiler
+{
+    SamplingProfiler() = default;
+    virtual ~SamplingProfiler() = default;
+    SamplingProfiler(SamplingProfiler const&) = delete;
+    SamplingProfiler& operator=(SamplingProfiler const&) = delete;
+
+    virtual void RegisterModule(std::string const& _loaded_path, std::string const& _logical_path,
+                                uint32_t _generation)
+    { (void)_loaded_path; (void)_logical_path; (void)_generation; }
+    // Symbolizes and aggregates everything sampled so far.
+    virtual void Drain() {}
+    // Drains, then forgets cached addresses since they may get reused by the next mapping.
+    virtual void OnModuleUnload() {}
+    // Brackets a module load or unload, samples are held off while the loader's maps change
+    // and counted as dropped instead.
+    virtual void BeginModuleChange() {}
+    virtual void EndModuleChange() {}
+    virtual bool WriteFolded(std::string const& _path) { (void)_path; return false; }
+};
+
+// SIGPROF driven on Linux, never samples elsewhere.
+// Must be created from the thread to sample.
+std::unique_ptr<SamplingProfiler> CreateSamplingProfiler(uint32_t _frequency);
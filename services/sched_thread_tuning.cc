@@ -0,0 +1,135 @@
+#include "thread_tuning.hpp"
+#include "async_logger.hpp"
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <string>
+
+struct SchedThreadTuning : public ThreadTuning
+{
+    explicit SchedThreadTuning(ThreadTuningOptions const& _options);
+
+    int64_t CurrentThread() const override;
+    bool ApplyPolicy(int64_t _thread, ThreadPolicy const& _policy) override;
+    bool LockMemory() override;
+    void ConfigureChildProcess() const override;
+
+    // Every online CPU but the frame ones, computed up front since the child can't call sysconf.
+    cpu_set_t child_cpus;
+};
+
+SchedThreadTuning::SchedThreadTuning(ThreadTuningOptions const& _options)
+    : ThreadTuning(_options)
+{
+    CPU_ZERO(&child_cpus);
+    if (options.frame_policy.cpus.empty())
+        return;
+
+    long const cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long cpu = 0; cpu < cpu_count && cpu < CPU_SETSIZE; ++cpu)
+        CPU_SET(cpu, &child_cpus);
+    for (uint32_t cpu : options.frame_policy.cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+            CPU_CLR(cpu, &child_cpus);
+    }
+}
+
+int64_t SchedThreadTuning::CurrentThread() const
+{
+    return (int64_t)syscall(SYS_gettid);
+}
+
+bool SchedThreadTuning::ApplyPolicy(int64_t _thread, ThreadPolicy const& _policy)
+{
+    bool applied = true;
+
+    if (!_policy.cpus.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (uint32_t cpu : _policy.cpus)
+        {
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &cpus);
+        }
+
+        if (sched_setaffinity((pid_t)_thread, sizeof(cpus), &cpus) != 0)
+        {
+            LoaderLog(bstk::kLogWarning, "couldn't pin thread {} (errno {})", _thread, errno);
+            applied = false;
+        }
+    }
+
+    if (_policy.priority > 0)
+    {
+        bool raised = false;
+        if (options.fifo)
+        {
+            sched_param parameters{};
+            parameters.sched_priority = std::clamp(_policy.priority,
+                                                   sched_get_priority_min(SCHED_FIFO),
+                                                   sched_get_priority_max(SCHED_FIFO));
+            raised = (sched_setscheduler((pid_t)_thread, SCHED_FIFO, &parameters) == 0);
+            if (!raised)
+            {
+                LoaderLog(bstk::kLogWarning, "SCHED_FIFO not allowed for thread {} (errno {}), falling back to nice",
+                          _thread, errno);
+            }
+        }
+
+        // Nice values are per thread on Linux.
+        if (!raised)
+        {
+            raised = (setpriority(PRIO_PROCESS, (id_t)_thread, -std::min(_policy.priority, 20)) == 0);
+            if (!raised)
+            {
+                LoaderLog(bstk::kLogWarning, "couldn't raise the priority of thread {} (errno {})", _thread, errno);
+            }
+        }
+        applied = applied && raised;
+    }
+
+    return applied;
+}
+
+bool SchedThreadTuning::LockMemory()
+{
+    // What is mapped once the baseline ran : the warmed up generation, packs, arenas. Not
+    // MCL_FUTURE, every later dlopen, thread stack and large malloc would count against
+    // RLIMIT_MEMLOCK and start failing once it is reached. Reloads are prefaulted instead.
+    if (mlockall(MCL_CURRENT) == 0)
+        return true;
+
+    int const error = errno;
+    rlimit limit{};
+    getrlimit(RLIMIT_MEMLOCK, &limit);
+    std::string const limit_text = (limit.rlim_cur == RLIM_INFINITY)
+        ? std::string("unlimited") : std::to_string(limit.rlim_cur >> 10) + "KB";
+    LoaderLog(bstk::kLogWarning, "mlockall failed (errno {}), RLIMIT_MEMLOCK is {}", error, limit_text.c_str());
+    return false;
+}
+
+void SchedThreadTuning::ConfigureChildProcess() const
+{
+    if (!active)
+        return;
+
+    // The child is a copy of the frame thread, its priority and pinned mask would be inherited
+    // by the build and every compiler it starts.
+    setpriority(PRIO_PROCESS, 0, 0);
+    if (CPU_COUNT(&child_cpus) > 0)
+        sched_setaffinity(0, sizeof(child_cpus), &child_cpus);
+}
+
+std::unique_ptr<ThreadTuning> CreateSchedThreadTuning(ThreadTuningOptions const& _options)
+{
+    return std::unique_ptr<ThreadTuning>(new SchedThreadTuning(_options));
+}
@@ -0,0 +1,169 @@
+#include "scratch_allocator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <new>
+#include <unordered_map>
+
+// Hands the thread's arena back to its allocator, if still alive, once the thread exits.
+struct ArenaLease
+{
+    ~ArenaLease() { Release(); }
+    void Release();
+
+    uint64_t owner_id = 0;
+    ScratchAllocator::Arena* arena = nullptr;
+};
+
+static std::mutex g_allocators_mutex;
+static std::unordered_map<uint64_t, ScratchAllocator*> g_allocators;
+static std::atomic<uint64_t> g_next_allocator_id{ 1 };
+static thread_local ArenaLease tls_lease;
+
+void ArenaLease::Release()
+{
+    if (!arena)
+        return;
+
+    std::lock_guard<std::mutex> lock{ g_allocators_mutex };
+    auto const owner = g_allocators.find(owner_id);
+    if (owner != g_allocators.end())
+        owner->second->ReleaseArena(*arena);
+    owner_id = 0;
+    arena = nullptr;
+}
+
+ScratchAllocator::ScratchAllocator(uint64_t _region_size, uint32_t _frames_in_flight)
+    : region_size{ _region_size }
+    , frames_in_flight{ std::clamp(_frames_in_flight, 1u, kMaxFramesInFlight) }
+    , id{ g_next_allocator_id++ }
+{
+    std::lock_guard<std::mutex> lock{ g_allocators_mutex };
+    g_allocators[id] = this;
+}
+
+ScratchAllocator::~ScratchAllocator()
+{
+    {
+        std::lock_guard<std::mutex> lock{ g_allocators_mutex };
+        g_allocators.erase(id);
+    }
+
+    for (std::unique_ptr<Arena>& arena : arenas)
+    {
+        for (uint32_t region = 0; region < frames_in_flight; ++region)
+            ResetRegion(*arena, region);
+    }
+}
+
+ScratchAllocator::Arena& ScratchAllocator::ThreadArena()
+{
+    if (tls_lease.owner_id == id)
+        return *tls_lease.arena;
+
+    // A thread only holds one arena, the one of another allocator goes back first.
+    tls_lease.Release();
+
+    std::lock_guard<std::mutex> lock{ arenas_mutex };
+    tls_lease.owner_id = id;
+
+    // Memory the previous thread handed out stays valid for frames_in_flight frames.
+    auto const reusable = std::find_if(free_arenas.begin(), free_arenas.end(), [this](Arena const* _arena) {
+        return frame_count >= _arena->released_frame + frames_in_flight;
+    });
+    if (reusable != free_arenas.end())
+    {
+        tls_lease.arena = *reusable;
+        free_arenas.erase(reusable);
+        return *tls_lease.arena;
+    }
+
+    std::unique_ptr<Arena> arena{ new Arena{} };
+    arena->memory.reset(new uint8_t[region_size * frames_in_flight]);
+    arenas.push_back(std::move(arena));
+    tls_lease.arena = arenas.back().get();
+    return *tls_lease.arena;
+}
+
+void ScratchAllocator::ReleaseArena(Arena& _arena)
+{
+    std::lock_guard<std::mutex> lock{ arenas_mutex };
+    _arena.released_frame = frame_count;
+    free_arenas.push_back(&_arena);
+}
+
+void ScratchAllocator::ResetRegion(Arena& _arena, uint32_t _region)
+{
+    Region& region = _arena.regions[_region];
+    for (OverflowBlock const& block : region.overflow_blocks)
+        ::operator delete(block.memory, std::align_val_t{ block.alignment });
+    region.overflow_blocks.clear();
+    region.offset = 0;
+}
+
+void* ScratchAllocator::Allocate(uint64_t _size, uint64_t _alignment)
+{
+    _alignment = std::max<uint64_t>(_alignment, 1u);
+    if ((_alignment & (_alignment - 1)) != 0)
+        return nullptr;
+
+    Arena& arena = ThreadArena();
+    Region& region = arena.regions[current_region];
+
+    uint8_t* const base = arena.memory.get() + region_size * current_region;
+    uintptr_t const cursor = (uintptr_t)(base + region.offset);
+    uintptr_t const aligned = (cursor + _alignment - 1) & ~(uintptr_t)(_alignment - 1);
+    uint64_t const end = (uint64_t)(aligned - (uintptr_t)base) + _size;
+
+    if (end <= region_size)
+    {
+        region.offset = end;
+        arena.high_water = std::max(arena.high_water, end);
+        return (void*)aligned;
+    }
+
+    ++arena.overflow_count;
+    arena.overflow_bytes += _size;
+
+    uint64_t const alignment = std::max<uint64_t>(_alignment, alignof(std::max_align_t));
+    void* block = ::operator new(std::max<uint64_t>(_size, 1u), std::align_val_t{ alignment }, std::nothrow);
+    if (block)
+        region.overflow_blocks.push_back(OverflowBlock{ block, alignment });
+    return block;
+}
+
+void ScratchAllocator::EndFrame()
+{
+    current_region = (current_region + 1) % frames_in_flight;
+
+    std::lock_guard<std::mutex> lock{ arenas_mutex };
+    ++frame_count;
+    for (std::unique_ptr<Arena>& arena : arenas)
+        ResetRegion(*arena, current_region);
+}
+
+void ScratchAllocator::PrintReport() const
+{
+    for (std::size_t index = 0; index < arenas.size(); ++index)
+    {
+        Arena const& arena = *arenas[index];
+        std::cout << "scratch arena " << index
+                  << " high water " << arena.high_water << "/" << region_size << " bytes"
+                  << " overflows " << arena.overflow_count
+                  << " (" << arena.overflow_bytes << " bytes)"
+                  << std::endl;
+    }
+}
+
+static void* HostScratchAlloc(void* _allocator, uint64_t _size, uint64_t _alignment)
+{
+    return ((ScratchAllocator*)_allocator)->Allocate(_size, _alignment);
+}
+
+void BindScratchAllocator(bstk::HostServices& _host, ScratchAllocator* _allocator)
+{
+    _host.scratch_allocator = _allocator;
+    _host.ScratchAlloc = HostScratchAlloc;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "loader/bstk.hpp"
+
+// Linear per-frame allocator, each thread allocating gets its own arena. Arenas of exited
+// threads go to the next new thread once the memory they handed out expired.
+// Every arena is split into one region per frame in flight : memory handed out during
+// frame N stays valid until frame N + frames_in_flight begins.
+// Regions running out fall back to the heap, those blocks go away with the region.
+// Engines must not allocate from other threads while the loader ends the frame.
+struct ScratchAllocator
+{
+    static constexpr uint32_t kMaxFramesInFlight = 4;
+
+    struct OverflowBlock
+    {
+        void* memory;
+        uint64_t alignment;
+    };
+
+    struct Region
+    {
+        uint64_t offset;
+        std::vector<OverflowBlock> overflow_blocks;
+    };
+
+    struct Arena
+    {
+        std::unique_ptr<uint8_t[]> memory;
+        Region regions[kMaxFramesInFlight];
+        uint64_t high_water;
+        uint64_t overflow_count;
+        uint64_t overflow_bytes;
+        uint64_t released_frame;
+    };
+
+    ScratchAllocator(uint64_t _region_size, uint32_t _frames_in_flight);
+    ~ScratchAllocator();
+    ScratchAllocator(ScratchAllocator const&) = delete;
+    ScratchAllocator& operator=(ScratchAllocator const&) = delete;
+
+    void* Allocate(uint64_t _size, uint64_t _alignment);
+    // Called by the loader once the frame is done with its scratch memory.
+    void EndFrame();
+    void PrintReport() const;
+
+    Arena& ThreadArena();
+    // Called when the thread owning _arena exits.
+    void ReleaseArena(Arena& _arena);
+    void ResetRegion(Arena& _arena, uint32_t _region);
+
+    uint64_t region_size;
+    uint32_t frames_in_flight;
+    uint32_t current_region = 0;
+    // Threads outlive allocators, they find theirs by id.
+    uint64_t id;
+
+    std::mutex arenas_mutex = {};
+    std::vector<std::unique_ptr<Arena>> arenas = {};
+    uint64_t frame_count = 0;
+    std::vector<Arena*> free_arenas = {};
+};
+
+void BindScratchAllocator(bstk::HostServices& _host, ScratchAllocator* _allocator);
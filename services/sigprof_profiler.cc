@@ -0,0 +1,291 @@
+#include "sampling_profiler.hpp"
+#include "async_logger.hpp"
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+static constexpr uint32_t kMaxDepth = 64;
+static constexpr uint32_t kRingSize = 4096;
+// Signal handler and kernel signal trampoline.
+static constexpr uint32_t kSkippedFrames = 2;
+
+struct Sample
+{
+    uint32_t depth;
+    void* pcs[kMaxDepth];
+};
+
+// Single producer (the signal handler) single consumer (Drain) ring.
+struct SampleRing
+{
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> dropped;
+    Sample samples[kRingSize];
+};
+
+static SampleRing* g_sample_ring = nullptr;
+
+static void SigprofHandler(int, siginfo_t*, void*)
+{
+    SampleRing* ring = g_sample_ring;
+    if (!ring)
+        return;
+
+    int const saved_errno = errno;
+
+    uint64_t const head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= kRingSize)
+    {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        Sample& sample = ring->samples[head % kRingSize];
+        sample.depth = (uint32_t)backtrace(sample.pcs, kMaxDepth);
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    errno = saved_errno;
+}
+
+struct ModuleGeneration
+{
+    std::string name;
+    uint32_t generation;
+};
+
+struct SigprofProfiler : public SamplingProfiler
+{
+    ~SigprofProfiler() override;
+
+    bool Init(uint32_t _frequency);
+
+    void RegisterModule(std::string const& _loaded_path, std::string const& _logical_path,
+                        uint32_t _generation) override;
+    void Drain() override;
+    void OnModuleUnload() override;
+    void BeginModuleChange() override;
+    void EndModuleChange() override;
+    bool WriteFolded(std::string const& _path) override;
+
+    std::string const& Symbolize(void* _pc);
+
+    timer_t timer = {};
+    bool timer_created = false;
+    sigset_t saved_mask = {};
+    struct sigaction previous_action = {};
+    std::unique_ptr<SampleRing> ring = nullptr;
+
+    std::unordered_map<std::string, ModuleGeneration> modules = {};
+    std::unordered_map<void*, std::string> symbol_cache = {};
+    std::unordered_map<std::string, uint64_t> folded_stacks = {};
+    uint64_t sample_count = 0;
+};
+
+static std::string BaseName(std::string const& _path)
+{
+    std::size_t const separator = _path.find_last_of('/');
+    return (separator == std::string::npos) ? _path : _path.substr(separator + 1);
+}
+
+bool SigprofProfiler::Init(uint32_t _frequency)
+{
+    ring.reset(new SampleRing{});
+
+    // backtrace lazily loads libgcc_s, which isn't signal safe, so get it done now.
+    void* warmup[4];
+    backtrace(warmup, 4);
+
+    struct sigaction action = {};
+    action.sa_sigaction = SigprofHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previous_action) != 0)
+        return false;
+
+    g_sample_ring = ring.get();
+
+    struct sigevent event = {};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event._sigev_un._tid = (pid_t)syscall(SYS_gettid);
+    // Wall clock rather than CPU time, so that time spent blocked shows up too.
+    if (timer_create(CLOCK_MONOTONIC, &event, &timer) != 0)
+        return false;
+    timer_created = true;
+
+    long const period_ns = 1000000000l / (long)std::max(_frequency, 1u);
+    struct itimerspec spec = {};
+    spec.it_interval.tv_sec = period_ns / 1000000000l;
+    spec.it_interval.tv_nsec = period_ns % 1000000000l;
+    spec.it_value = spec.it_interval;
+    return timer_settime(timer, 0, &spec, nullptr) == 0;
+}
+
+SigprofProfiler::~SigprofProfiler()
+{
+    if (timer_created)
+        timer_delete(timer);
+    g_sample_ring = nullptr;
+    sigaction(SIGPROF, &previous_action, nullptr);
+}
+
+void SigprofProfiler::RegisterModule(std::string const& _loaded_path, std::string const& _logical_path,
+                                     uint32_t _generation)
+{
+    modules[_loaded_path] = ModuleGeneration{ BaseName(_logical_path), _generation };
+}
+
+std::string const& SigprofProfiler::Symbolize(void* _pc)
+{
+    auto cached = symbol_cache.find(_pc);
+    if (cached != symbol_cache.end())
+        return cached->second;
+
+    std::string name;
+    Dl_info info = {};
+    if (dladdr(_pc, &info) && info.dli_fname)
+    {
+        auto module = modules.find(info.dli_fname);
+        if (module != modules.end())
+            name = module->second.name + "@" + std::to_string(module->second.generation);
+        else
+            name = BaseName(info.dli_fname);
+
+        name += "`";
+        if (info.dli_sname)
+        {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            name += (status == 0 && demangled) ? demangled : info.dli_sname;
+            std::free(demangled);
+        }
+        else
+        {
+            char offset[32];
+            std::snprintf(offset, sizeof(offset), "+0x%zx", (size_t)((char*)_pc - (char*)info.dli_fbase));
+            name += offset;
+        }
+    }
+    else
+    {
+        char address[32];
+        std::snprintf(address, sizeof(address), "0x%zx", (size_t)_pc);
+        name = address;
+    }
+
+    // ';' separates frames in the folded format.
+    for (char& c : name)
+        c = (c == ';') ? ':' : c;
+
+    return symbol_cache.emplace(_pc, std::move(name)).first->second;
+}
+
+void SigprofProfiler::Drain()
+{
+    uint64_t const head = ring->head.load(std::memory_order_acquire);
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+
+    std::string stack;
+    for (; tail != head; ++tail)
+    {
+        Sample const& sample = ring->samples[tail % kRingSize];
+
+        stack.clear();
+        for (uint32_t frame = sample.depth; frame > kSkippedFrames; --frame)
+        {
+            uint32_t const index = frame - 1;
+            // Return addresses point past the call, step back into it. The interrupted pc is exact.
+            char* pc = (char*)sample.pcs[index] - ((index > kSkippedFrames) ? 1 : 0);
+            if (!stack.empty())
+                stack += ';';
+            stack += Symbolize(pc);
+        }
+
+        if (!stack.empty())
+        {
+            ++folded_stacks[stack];
+            ++sample_count;
+        }
+    }
+
+    ring->tail.store(tail, std::memory_order_release);
+}
+
+void SigprofProfiler::OnModuleUnload()
+{
+    Drain();
+    symbol_cache.clear();
+}
+
+void SigprofProfiler::BeginModuleChange()
+{
+    // backtrace walks the unwind tables dlopen / dlclose are rewriting.
+    sigset_t profile_signal;
+    sigemptyset(&profile_signal);
+    sigaddset(&profile_signal, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &profile_signal, &saved_mask);
+}
+
+void SigprofProfiler::EndModuleChange()
+{
+    // A blocked timer signal stays pending once, later expirations are overruns.
+    sigset_t profile_signal;
+    sigemptyset(&profile_signal);
+    sigaddset(&profile_signal, SIGPROF);
+    timespec const no_wait = {};
+    if (sigtimedwait(&profile_signal, nullptr, &no_wait) == SIGPROF)
+    {
+        int const overruns = timer_created ? timer_getoverrun(timer) : 0;
+        ring->dropped.fetch_add(1 + (uint64_t)std::max(overruns, 0), std::memory_order_relaxed);
+    }
+    pthread_sigmask(SIG_SETMASK, &saved_mask, nullptr);
+}
+
+bool SigprofProfiler::WriteFolded(std::string const& _path)
+{
+    Drain();
+
+    std::ofstream file(_path);
+    if (!file)
+    {
+        LoaderLog(bstk::kLogError, "couldn't open {}", _path.c_str());
+        return false;
+    }
+
+    for (auto const& stack : folded_stacks)
+        file << stack.first << " " << stack.second << "\n";
+
+    LoaderLog(bstk::kLogInfo, "profile : {} samples written to {} ({} dropped)",
+              sample_count, _path.c_str(), ring->dropped.load());
+    return (bool)file;
+}
+
+std::unique_ptr<SamplingProfiler> CreateSigprofProfiler(uint32_t _frequency)
+{
+    std::unique_ptr<SigprofProfiler> profiler{ new SigprofProfiler() };
+    if (!profiler->Init(_frequency))
+    {
+        LoaderLog(bstk::kLogError, "couldn't start the sampling profiler");
+        return nullptr;
+    }
+    return profiler;
+}
@@ -0,0 +1,212 @@
+#include "task_scheduler.hpp"
+
+#include <coroutine>
+#include <iostream>
+
+TaskScheduler::TaskScheduler(FileService& _file_service, ThreadTuning* _thread_tuning, uint32_t _worker_count)
+    : file_service{ _file_service }
+    , thread_tuning{ _thread_tuning }
+{
+    workers.resize(_worker_count);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    DropAll();
+
+    {
+        std::lock_guard<std::mutex> lock{ job_mutex };
+        stop = true;
+    }
+    job_condition.notify_all();
+    for (std::thread& worker : workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+}
+
+void TaskScheduler::Spawn(void* _handle)
+{
+    ++spawned_count;
+    phase_waits[bstk::kTaskPhaseFrameBegin].push_back(_handle);
+}
+
+void TaskScheduler::ResumeAtPhase(void* _handle, bstk::eTaskPhase _phase)
+{
+    phase_waits[_phase < bstk::kTaskPhaseCount ? _phase : bstk::kTaskPhaseFrameBegin].push_back(_handle);
+}
+
+void TaskScheduler::ResumeOnFile(void* _handle, bstk::FileRequest* _request)
+{
+    ++file_wait_count;
+    file_waits.push_back(FileWait{ _handle, _request });
+}
+
+void TaskScheduler::ResumeAfterJob(void* _handle, void (*_job)(void*), void* _data)
+{
+    ++job_count;
+
+    // Without workers the job runs right away, the task still resumes at the next phase.
+    if (workers.empty())
+    {
+        _job(_data);
+        std::lock_guard<std::mutex> lock{ job_mutex };
+        finished_jobs.push_back(_handle);
+        return;
+    }
+
+    // Workers are started by the first job, most engines never use them.
+    if (!workers.front().joinable())
+    {
+        for (std::thread& worker : workers)
+            worker = std::thread([this]() { WorkerMain(); });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ job_mutex };
+        queued_jobs.push_back(Job{ _handle, _job, _data });
+    }
+    job_condition.notify_one();
+}
+
+void TaskScheduler::WorkerMain()
+{
+    if (thread_tuning)
+        thread_tuning->ConfigureWorkerThread();
+
+    std::unique_lock<std::mutex> lock{ job_mutex };
+    for (;;)
+    {
+        job_condition.wait(lock, [this]() { return stop || !queued_jobs.empty(); });
+        if (stop)
+            return;
+
+        Job const job = queued_jobs.front();
+        queued_jobs.erase(queued_jobs.begin());
+        ++running_jobs;
+
+        lock.unlock();
+        job.job(job.data);
+        lock.lock();
+
+        --running_jobs;
+        finished_jobs.push_back(job.handle);
+        idle_condition.notify_all();
+    }
+}
+
+void TaskScheduler::Resume(void* _handle)
+{
+    std::coroutine_handle<> const handle = std::coroutine_handle<>::from_address(_handle);
+    ++resume_count;
+    handle.resume();
+    if (handle.done())
+    {
+        ++completed_count;
+        handle.destroy();
+    }
+}
+
+void TaskScheduler::RunPhase(bstk::eTaskPhase _phase)
+{
+    // Tasks waiting again for the same phase are only resumed at the next frame.
+    resuming.swap(phase_waits[_phase]);
+
+    std::size_t pending_count = 0;
+    for (FileWait const& wait : file_waits)
+    {
+        if (wait.request->status == bstk::kFilePending)
+            file_waits[pending_count++] = wait;
+        else
+            resuming.push_back(wait.handle);
+    }
+    file_waits.resize(pending_count);
+
+    {
+        std::lock_guard<std::mutex> lock{ job_mutex };
+        resuming.insert(resuming.end(), finished_jobs.begin(), finished_jobs.end());
+        finished_jobs.clear();
+    }
+
+    for (void* handle : resuming)
+        Resume(handle);
+    resuming.clear();
+}
+
+uint32_t TaskScheduler::DropAll()
+{
+    std::vector<void*> dropped{};
+
+    {
+        std::unique_lock<std::mutex> lock{ job_mutex };
+        for (Job const& job : queued_jobs)
+            dropped.push_back(job.handle);
+        queued_jobs.clear();
+
+        // Running jobs execute module code and write into the task frames.
+        idle_condition.wait(lock, [this]() { return running_jobs == 0; });
+        dropped.insert(dropped.end(), finished_jobs.begin(), finished_jobs.end());
+        finished_jobs.clear();
+    }
+
+    // Requests usually live in the task frames, the service must let go of them first.
+    for (FileWait const& wait : file_waits)
+    {
+        file_service.Release(wait.request);
+        dropped.push_back(wait.handle);
+    }
+    file_waits.clear();
+
+    for (std::vector<void*>& waits : phase_waits)
+    {
+        dropped.insert(dropped.end(), waits.begin(), waits.end());
+        waits.clear();
+    }
+
+    for (void* handle : dropped)
+        std::coroutine_handle<>::from_address(handle).destroy();
+
+    dropped_count += dropped.size();
+    return (uint32_t)dropped.size();
+}
+
+void TaskScheduler::PrintReport() const
+{
+    if (spawned_count == 0)
+        return;
+
+    std::cout << "tasks: " << spawned_count << " spawned, " << completed_count << " completed, "
+              << dropped_count << " dropped by reloads, " << resume_count << " resumes, "
+              << file_wait_count << " file waits, " << job_count << " jobs"
+              << std::endl;
+}
+
+static void HostSpawnTask(void* _scheduler, void* _handle)
+{
+    ((TaskScheduler*)_scheduler)->Spawn(_handle);
+}
+
+static void HostResumeAtPhase(void* _scheduler, void* _handle, bstk::eTaskPhase _phase)
+{
+    ((TaskScheduler*)_scheduler)->ResumeAtPhase(_handle, _phase);
+}
+
+static void HostResumeOnFile(void* _scheduler, void* _handle, bstk::FileRequest* _request)
+{
+    ((TaskScheduler*)_scheduler)->ResumeOnFile(_handle, _request);
+}
+
+static void HostResumeAfterJob(void* _scheduler, void* _handle, void (*_job)(void*), void* _data)
+{
+    ((TaskScheduler*)_scheduler)->ResumeAfterJob(_handle, _job, _data);
+}
+
+void BindTaskScheduler(bstk::HostServices& _host, TaskScheduler* _scheduler)
+{
+    _host.task_scheduler = _scheduler;
+    _host.SpawnTask = HostSpawnTask;
+    _host.ResumeAtPhase = HostResumeAtPhase;
+    _host.ResumeOnFile = HostResumeOnFile;
+    _host.ResumeAfterJob = HostResumeAfterJob;
+}
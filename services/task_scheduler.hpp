@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "loader/bstk.hpp"
+#include "file_service.hpp"
+#include "thread_tuning.hpp"
+
+// Resumes engine coroutines (std::coroutine_handle<> addresses) on the frame thread at the frame
+// phases, once their file request completed or once their job returned from a worker thread.
+// Everything but the job queue is only touched by the frame thread.
+struct TaskScheduler
+{
+    struct FileWait
+    {
+        void* handle;
+        bstk::FileRequest* request;
+    };
+
+    struct Job
+    {
+        void* handle;
+        void (*job)(void*);
+        void* data;
+    };
+
+    TaskScheduler(FileService& _file_service, ThreadTuning* _thread_tuning, uint32_t _worker_count);
+    ~TaskScheduler();
+    TaskScheduler(TaskScheduler const&) = delete;
+    TaskScheduler& operator=(TaskScheduler const&) = delete;
+
+    void Spawn(void* _handle);
+    void ResumeAtPhase(void* _handle, bstk::eTaskPhase _phase);
+    void ResumeOnFile(void* _handle, bstk::FileRequest* _request);
+    void ResumeAfterJob(void* _handle, void (*_job)(void*), void* _data);
+
+    // Resumes the tasks waiting for _phase, then those whose read or job completed.
+    void RunPhase(bstk::eTaskPhase _phase);
+    // Destroys every suspended task while its code is still loaded: jobs in flight are waited
+    // for and pending reads are cancelled first. Returns the number of tasks destroyed.
+    uint32_t DropAll();
+    void PrintReport() const;
+
+    void WorkerMain();
+    void Resume(void* _handle);
+
+    FileService& file_service;
+    ThreadTuning* thread_tuning;
+
+    std::vector<void*> phase_waits[bstk::kTaskPhaseCount] = {};
+    std::vector<void*> resuming = {};
+    std::vector<FileWait> file_waits = {};
+
+    std::mutex job_mutex = {};
+    std::condition_variable job_condition = {};
+    std::condition_variable idle_condition = {};
+    std::vector<Job> queued_jobs = {};
+    std::vector<void*> finished_jobs = {};
+    uint32_t running_jobs = 0;
+    bool stop = false;
+    std::vector<std::thread> workers = {};
+
+    uint64_t spawned_count = 0;
+    uint64_t completed_count = 0;
+    uint64_t resume_count = 0;
+    uint64_t file_wait_count = 0;
+    uint64_t job_count = 0;
+    uint64_t dropped_count = 0;
+};
+
+void BindTaskScheduler(bstk::HostServices& _host, TaskScheduler* _scheduler);
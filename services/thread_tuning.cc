@@ -0,0 +1,112 @@
+#include "thread_tuning.hpp"
+#include "async_logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(__linux__)
+std::unique_ptr<ThreadTuning> CreateSchedThreadTuning(ThreadTuningOptions const& _options);
+#endif
+
+void ThreadTuning::JitterWindow::Record(uint64_t _frame_us)
+{
+    histogram.Record(_frame_us);
+    sum += (double)_frame_us;
+    square_sum += (double)_frame_us * (double)_frame_us;
+}
+
+ThreadTuning::ThreadTuning(ThreadTuningOptions const& _options)
+    : options{ _options }
+{}
+
+bool ThreadTuning::Enabled() const
+{
+    return !options.frame_policy.cpus.empty() || options.frame_policy.priority > 0
+        || !options.worker_policy.cpus.empty() || options.worker_policy.priority > 0
+        || options.lock_memory;
+}
+
+void ThreadTuning::OnFrame(uint64_t _frame_us)
+{
+    if (!Enabled())
+        return;
+
+    (active ? tuned : baseline).Record(_frame_us);
+    if (!active && ++frame_count >= options.baseline_frames)
+        Activate();
+}
+
+void ThreadTuning::Activate()
+{
+    if (active || !Enabled())
+        return;
+    active = true;
+
+    if (!ApplyPolicy(CurrentThread(), options.frame_policy))
+        LoaderLog(bstk::kLogWarning, "frame thread policy not fully applied");
+
+    if (options.lock_memory && !LockMemory())
+        LoaderLog(bstk::kLogWarning, "memory not locked");
+
+    std::lock_guard<std::mutex> lock{ worker_mutex };
+    for (int64_t thread : worker_threads)
+        ApplyPolicy(thread, options.worker_policy);
+}
+
+void ThreadTuning::ConfigureWorkerThread()
+{
+    int64_t const thread = CurrentThread();
+
+    std::lock_guard<std::mutex> lock{ worker_mutex };
+    worker_threads.push_back(thread);
+    if (active)
+        ApplyPolicy(thread, options.worker_policy);
+}
+
+static void PrintJitter(char const* _label, ThreadTuning::JitterWindow const& _window)
+{
+    uint64_t const count = _window.histogram.sample_count;
+    if (count == 0)
+        return;
+
+    double const mean = _window.sum / (double)count;
+    double const variance = std::max(0.0, _window.square_sum / (double)count - mean * mean);
+    std::cout << "\t" << _label << " over " << count << " frames"
+              << " p50 " << _window.histogram.ValueAtPercentile(50.0) << "us"
+              << " p99 " << _window.histogram.ValueAtPercentile(99.0) << "us"
+              << " p99.9 " << _window.histogram.ValueAtPercentile(99.9) << "us"
+              << " max " << _window.histogram.max_value << "us"
+              << " stddev " << std::sqrt(variance) << "us"
+              << std::endl;
+}
+
+void ThreadTuning::PrintReport() const
+{
+    if (!Enabled())
+        return;
+
+    std::cout << "frame jitter before and after thread tuning" << std::endl;
+    PrintJitter("default", baseline);
+    PrintJitter("tuned", tuned);
+}
+
+static void HostConfigureWorkerThread(void* _tuning)
+{
+    ((ThreadTuning*)_tuning)->ConfigureWorkerThread();
+}
+
+std::unique_ptr<ThreadTuning> CreateThreadTuning(ThreadTuningOptions const& _options)
+{
+#if defined(__linux__)
+    return CreateSchedThreadTuning(_options);
+#else
+    return std::unique_ptr<ThreadTuning>(new ThreadTuning(_options));
+#endif
+}
+
+void BindThreadTuning(bstk::HostServices& _host, ThreadTuning* _tuning)
+{
+    _host.thread_tuning = _tuning;
+    _host.ConfigureWorkerThread = HostConfigureWorkerThread;
+}
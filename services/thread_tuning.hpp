@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "loader/bstk.hpp"
+#include "frame_stats.hpp"
+
+struct ThreadPolicy
+{
+    // Empty leaves the affinity alone.
+    std::vector<uint32_t> cpus = {};
+    // Raise over the default priority (nice decrement, or SCHED_FIFO priority), 0 leaves it alone.
+    int32_t priority = 0;
+};
+
+struct ThreadTuningOptions
+{
+    ThreadPolicy frame_policy = {};
+    ThreadPolicy worker_policy = {};
+    // Priorities use SCHED_FIFO when allowed, nice otherwise.
+    bool fifo = false;
+    // Locks the pages mapped when the policies are applied, later mappings stay pageable.
+    bool lock_memory = false;
+    // Frames measured with default scheduling before the policies are applied.
+    uint32_t baseline_frames = 300;
+};
+
+// Scheduling of the frame thread and of worker threads (loader or engine owned): CPU
+// affinity, priority and locked memory. Frame time jitter is measured over a baseline
+// window with default scheduling first, then with the policies applied.
+struct ThreadTuning
+{
+    struct JitterWindow
+    {
+        void Record(uint64_t _frame_us);
+
+        LogHistogram histogram = {};
+        double sum = 0.0;
+        double square_sum = 0.0;
+    };
+
+    explicit ThreadTuning(ThreadTuningOptions const& _options);
+    virtual ~ThreadTuning() = default;
+    ThreadTuning(ThreadTuning const&) = delete;
+    ThreadTuning& operator=(ThreadTuning const&) = delete;
+
+    bool Enabled() const;
+    // Called by the frame thread once per frame, activates after the baseline window.
+    void OnFrame(uint64_t _frame_us);
+    // Applies the frame policy to the calling thread, the worker policy to registered workers.
+    void Activate();
+    // Registers the calling thread as a worker, it follows the worker policy once active.
+    void ConfigureWorkerThread();
+    void PrintReport() const;
+
+    // Platform side, _thread comes from CurrentThread.
+    virtual int64_t CurrentThread() const { return 0; }
+    virtual bool ApplyPolicy(int64_t _thread, ThreadPolicy const& _policy)
+    { (void)_thread; (void)_policy; return false; }
+    virtual bool LockMemory() { return false; }
+    // Child processes (builds) get the default policy and stay off the frame CPUs. Runs in
+    // the forked child before exec, async-signal-safe calls only.
+    virtual void ConfigureChildProcess() const {}
+
+    ThreadTuningOptions options;
+    // Set by the frame thread, read by workers registering and by forked builds.
+    std::atomic<bool> active = false;
+    uint64_t frame_count = 0;
+    JitterWindow baseline = {};
+    JitterWindow tuned = {};
+
+    std::mutex worker_mutex = {};
+    std::vector<int64_t> worker_threads = {};
+};
+
+// sched_setaffinity / sched_setscheduler based on Linux, only measures elsewhere.
+std::unique_ptr<ThreadTuning> CreateThreadTuning(ThreadTuningOptions const& _options);
+void BindThreadTuning(bstk::HostServices& _host, ThreadTuning* _tuning);
@@ -0,0 +1,577 @@
+#include "file_service.hpp"
+#include "async_logger.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+
+static constexpr uint32_t kRingEntries = 64;
+static constexpr uint32_t kMaxOps = kRingEntries;
+static constexpr uint32_t kBufferCount = 8;
+static constexpr uint64_t kBufferSize = 1u << 20;
+// user_data of cancellations, the low bits hold the index of the cancelled op.
+static constexpr uint64_t kCancelTag = 1ull << 32;
+
+enum eUringStage : uint32_t
+{
+    kStageFree = 0u,
+    kStageOpen,
+    kStageStat,
+    kStageWaitBuffer,
+    kStageRead,
+    kStageClose
+};
+
+struct UringOp
+{
+    bstk::FileRequest* request;
+    std::string path;
+    uint32_t stage;
+    int fd;
+    int32_t buffer_index;
+    uint8_t* buffer;
+    uint64_t size;
+    uint64_t bytes_read;
+    struct statx stx;
+};
+
+struct UringFileService : public FileService
+{
+    ~UringFileService() override;
+
+    bool Init();
+
+    bool Submit(bstk::FileRequest* _request) override;
+    void Release(bstk::FileRequest* _request) override;
+    void Update() override;
+
+    io_uring_sqe* NextSqe(uint32_t _op_index, uint8_t _opcode);
+    void QueueOpen(uint32_t _op_index);
+    void QueueStat(uint32_t _op_index);
+    void QueueRead(uint32_t _op_index);
+    void QueueClose(uint32_t _op_index);
+    void CancelRead(uint32_t _op_index);
+    void Complete(uint32_t _op_index, int32_t _result);
+    void Fail(uint32_t _op_index, int32_t _error);
+    bool StartOp(bstk::FileRequest* _request);
+    bool AcquireBuffer(UringOp& _op);
+    void ReleaseBuffer(int32_t _buffer_index);
+    uint32_t Reap();
+
+    int ring_fd = -1;
+
+    void* sq_memory = MAP_FAILED;
+    size_t sq_memory_size = 0;
+    void* cq_memory = MAP_FAILED;
+    size_t cq_memory_size = 0;
+    io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+    size_t sqes_size = 0;
+
+    uint32_t* sq_head = nullptr;
+    uint32_t* sq_tail = nullptr;
+    uint32_t* sq_array = nullptr;
+    uint32_t sq_mask = 0;
+    uint32_t sq_entries = 0;
+    uint32_t* cq_head = nullptr;
+    uint32_t* cq_tail = nullptr;
+    uint32_t cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    uint32_t sq_local_tail = 0;
+    uint32_t queued_sqes = 0;
+    uint32_t active_ops = 0;
+    uint32_t pending_cancels = 0;
+
+    uint8_t* buffer_memory = (uint8_t*)MAP_FAILED;
+    bool buffers_registered = false;
+    std::array<bool, kBufferCount> buffer_in_use = {};
+
+    std::array<UringOp, kMaxOps> ops = {};
+    std::deque<bstk::FileRequest*> backlog = {};
+};
+
+static int UringSetup(uint32_t _entries, io_uring_params* _params)
+{
+    return (int)syscall(__NR_io_uring_setup, _entries, _params);
+}
+
+static int UringEnter(int _fd, uint32_t _to_submit, uint32_t _min_complete, uint32_t _flags)
+{
+    return (int)syscall(__NR_io_uring_enter, _fd, _to_submit, _min_complete, _flags, nullptr, 0);
+}
+
+static int UringRegister(int _fd, uint32_t _opcode, void const* _arg, uint32_t _count)
+{
+    return (int)syscall(__NR_io_uring_register, _fd, _opcode, _arg, _count);
+}
+
+bool UringFileService::Init()
+{
+    io_uring_params params{};
+    ring_fd = UringSetup(kRingEntries, &params);
+    if (ring_fd < 0)
+        return false;
+
+    // OPENAT/STATX/CLOSE and the single mmap layout are all 5.6+, NODROP is a good proxy.
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP))
+        return false;
+
+    sq_memory_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_memory_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sq_memory_size = std::max(sq_memory_size, cq_memory_size);
+
+    sq_memory = mmap(nullptr, sq_memory_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring_fd, IORING_OFF_SQ_RING);
+    if (sq_memory == MAP_FAILED)
+        return false;
+    cq_memory = sq_memory;
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = (io_uring_sqe*)mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                               ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+
+    uint8_t* const sq_base = (uint8_t*)sq_memory;
+    sq_head = (uint32_t*)(sq_base + params.sq_off.head);
+    sq_tail = (uint32_t*)(sq_base + params.sq_off.tail);
+    sq_array = (uint32_t*)(sq_base + params.sq_off.array);
+    sq_mask = *(uint32_t*)(sq_base + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sq_local_tail = *sq_tail;
+
+    uint8_t* const cq_base = (uint8_t*)cq_memory;
+    cq_head = (uint32_t*)(cq_base + params.cq_off.head);
+    cq_tail = (uint32_t*)(cq_base + params.cq_off.tail);
+    cq_mask = *(uint32_t*)(cq_base + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe*)(cq_base + params.cq_off.cqes);
+
+    buffer_memory = (uint8_t*)mmap(nullptr, kBufferCount * kBufferSize, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer_memory == MAP_FAILED)
+        return false;
+
+    std::array<iovec, kBufferCount> iovecs{};
+    for (uint32_t index = 0; index < kBufferCount; ++index)
+        iovecs[index] = iovec{ buffer_memory + index * kBufferSize, kBufferSize };
+
+    // Fails when RLIMIT_MEMLOCK is too low, plain reads into the same memory still work.
+    buffers_registered =
+        (UringRegister(ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), kBufferCount) == 0);
+    if (!buffers_registered)
+        LoaderLog(bstk::kLogWarning, "io_uring buffer registration failed");
+
+    for (uint32_t index = 0; index < kMaxOps; ++index)
+        ops[index].stage = kStageFree;
+
+    return true;
+}
+
+UringFileService::~UringFileService()
+{
+    if (ring_fd >= 0)
+    {
+        for (UringOp& op : ops)
+            op.request = nullptr;
+        backlog.clear();
+
+        // Drain in-flight operations so that no fd is left open behind our back.
+        while (active_ops > 0)
+        {
+            for (uint32_t index = 0; index < kMaxOps; ++index)
+            {
+                if (ops[index].stage == kStageWaitBuffer)
+                    QueueClose(index);
+            }
+
+            __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+            uint32_t const to_submit = queued_sqes;
+            queued_sqes = 0;
+            if (UringEnter(ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+                break;
+            Reap();
+        }
+    }
+
+    if (buffer_memory != MAP_FAILED)
+        munmap(buffer_memory, kBufferCount * kBufferSize);
+    if (sqes != MAP_FAILED)
+        munmap(sqes, sqes_size);
+    if (sq_memory != MAP_FAILED)
+        munmap(sq_memory, sq_memory_size);
+    if (ring_fd >= 0)
+        close(ring_fd);
+}
+
+io_uring_sqe* UringFileService::NextSqe(uint32_t _op_index, uint8_t _opcode)
+{
+    // Every op has at most one sqe queued, kMaxOps <= sq_entries guarantees a free slot.
+    uint32_t const index = sq_local_tail & sq_mask;
+
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->opcode = _opcode;
+    sqe->user_data = _op_index;
+
+    sq_array[index] = index;
+    ++sq_local_tail;
+    ++queued_sqes;
+    return sqe;
+}
+
+void UringFileService::QueueOpen(uint32_t _op_index)
+{
+    UringOp& op = ops[_op_index];
+    op.stage = kStageOpen;
+
+    io_uring_sqe* sqe = NextSqe(_op_index, IORING_OP_OPENAT);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)op.path.c_str();
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+}
+
+void UringFileService::QueueStat(uint32_t _op_index)
+{
+    UringOp& op = ops[_op_index];
+    op.stage = kStageStat;
+
+    io_uring_sqe* sqe = NextSqe(_op_index, IORING_OP_STATX);
+    sqe->fd = op.fd;
+    sqe->addr = (uint64_t)"";
+    sqe->len = STATX_SIZE;
+    sqe->statx_flags = AT_EMPTY_PATH;
+    sqe->off = (uint64_t)&op.stx;
+}
+
+void UringFileService::QueueRead(uint32_t _op_index)
+{
+    UringOp& op = ops[_op_index];
+    op.stage = kStageRead;
+
+    bool const fixed = (op.buffer_index >= 0) && buffers_registered;
+    io_uring_sqe* sqe = NextSqe(_op_index, fixed ? IORING_OP_READ_FIXED : IORING_OP_READ);
+    sqe->fd = op.fd;
+    sqe->addr = (uint64_t)(op.buffer + op.bytes_read);
+    sqe->len = (uint32_t)std::min<uint64_t>(op.size - op.bytes_read, 1u << 30);
+    sqe->off = (op.request ? op.request->offset : 0u) + op.bytes_read;
+    if (fixed)
+        sqe->buf_index = (uint16_t)op.buffer_index;
+}
+
+void UringFileService::QueueClose(uint32_t _op_index)
+{
+    ops[_op_index].stage = kStageClose;
+
+    io_uring_sqe* sqe = NextSqe(_op_index, IORING_OP_CLOSE);
+    sqe->fd = ops[_op_index].fd;
+}
+
+// The kernel may still be writing into the engine's buffer, which can go away once the
+// request is released: waits until both the read and its cancellation completed.
+void UringFileService::CancelRead(uint32_t _op_index)
+{
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    if (queued_sqes > 0)
+    {
+        int const submitted = UringEnter(ring_fd, queued_sqes, 0, 0);
+        if (submitted > 0)
+            queued_sqes -= (uint32_t)submitted;
+    }
+
+    // Without a free slot the read is simply waited for.
+    if (sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) < sq_entries)
+    {
+        io_uring_sqe* sqe = NextSqe(_op_index, IORING_OP_ASYNC_CANCEL);
+        sqe->addr = _op_index;
+        sqe->user_data = kCancelTag | _op_index;
+        ++pending_cancels;
+    }
+
+    while (ops[_op_index].stage == kStageRead || pending_cancels > 0)
+    {
+        __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+        uint32_t const to_submit = queued_sqes;
+        queued_sqes = 0;
+        if (UringEnter(ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+        {
+            LoaderLog(bstk::kLogError, "io_uring wait failed while cancelling a read");
+            break;
+        }
+        Reap();
+    }
+}
+
+bool UringFileService::AcquireBuffer(UringOp& _op)
+{
+    for (uint32_t index = 0; index < kBufferCount; ++index)
+    {
+        if (!buffer_in_use[index])
+        {
+            buffer_in_use[index] = true;
+            _op.buffer_index = (int32_t)index;
+            _op.buffer = buffer_memory + index * kBufferSize;
+            return true;
+        }
+    }
+    return false;
+}
+
+void UringFileService::ReleaseBuffer(int32_t _buffer_index)
+{
+    if (_buffer_index >= 0)
+        buffer_in_use[_buffer_index] = false;
+}
+
+void UringFileService::Fail(uint32_t _op_index, int32_t _error)
+{
+    UringOp& op = ops[_op_index];
+    if (op.request)
+    {
+        op.request->error = _error;
+        op.request->status = bstk::kFileFailed;
+        op.request = nullptr;
+    }
+    ReleaseBuffer(op.buffer_index);
+    op.buffer_index = -1;
+
+    if (op.fd >= 0)
+        QueueClose(_op_index);
+    else
+    {
+        op.stage = kStageFree;
+        --active_ops;
+    }
+}
+
+void UringFileService::Complete(uint32_t _op_index, int32_t _result)
+{
+    UringOp& op = ops[_op_index];
+
+    switch (op.stage)
+    {
+    case kStageOpen:
+    {
+        if (_result < 0)
+            return Fail(_op_index, -_result);
+
+        op.fd = _result;
+        if (!op.request)
+            return QueueClose(_op_index);
+        if (op.size == 0)
+            return QueueStat(_op_index);
+        op.stage = kStageWaitBuffer;
+    } break;
+
+    case kStageStat:
+    {
+        if (_result < 0)
+            return Fail(_op_index, -_result);
+        if (!op.request)
+            return QueueClose(_op_index);
+
+        uint64_t const offset = op.request->offset;
+        op.size = (op.stx.stx_size > offset) ? op.stx.stx_size - offset : 0u;
+        if (op.size == 0)
+        {
+            op.request->data = op.request->buffer;
+            op.request->status = bstk::kFileDone;
+            op.request = nullptr;
+            return QueueClose(_op_index);
+        }
+        op.stage = kStageWaitBuffer;
+    } break;
+
+    case kStageRead:
+    {
+        if (_result < 0)
+            return Fail(_op_index, -_result);
+
+        op.bytes_read += (uint64_t)_result;
+        if (op.request && _result > 0 && op.bytes_read < op.size)
+            return QueueRead(_op_index);
+
+        if (op.request)
+        {
+            op.request->data = op.buffer;
+            op.request->bytes_read = op.bytes_read;
+            op.request->status = bstk::kFileDone;
+            op.request = nullptr;
+        }
+        else
+        {
+            ReleaseBuffer(op.buffer_index);
+        }
+        op.buffer_index = -1;
+        QueueClose(_op_index);
+    } break;
+
+    case kStageClose:
+    {
+        op.stage = kStageFree;
+        op.fd = -1;
+        op.path.clear();
+        --active_ops;
+    } break;
+
+    default: break;
+    }
+}
+
+uint32_t UringFileService::Reap()
+{
+    uint32_t reaped = 0;
+    uint32_t head = *cq_head;
+    uint32_t const tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head, ++reaped)
+    {
+        io_uring_cqe const& cqe = cqes[head & cq_mask];
+        if (cqe.user_data & kCancelTag)
+            --pending_cancels;
+        else
+            Complete((uint32_t)cqe.user_data, cqe.res);
+    }
+
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+bool UringFileService::StartOp(bstk::FileRequest* _request)
+{
+    for (uint32_t index = 0; index < kMaxOps; ++index)
+    {
+        UringOp& op = ops[index];
+        if (op.stage != kStageFree)
+            continue;
+
+        op.request = _request;
+        op.path = _request->path;
+        op.fd = -1;
+        op.buffer_index = -1;
+        op.buffer = (uint8_t*)_request->buffer;
+        op.size = _request->size;
+        op.bytes_read = 0;
+        ++active_ops;
+        QueueOpen(index);
+        return true;
+    }
+    return false;
+}
+
+bool UringFileService::Submit(bstk::FileRequest* _request)
+{
+    // The size of an engine buffer is only known through the request.
+    if (_request->buffer && _request->size == 0)
+    {
+        _request->error = EINVAL;
+        _request->status = bstk::kFileFailed;
+        return false;
+    }
+
+    if (!_request->buffer && _request->size > kBufferSize)
+    {
+        _request->error = EFBIG;
+        _request->status = bstk::kFileFailed;
+        return false;
+    }
+
+    _request->status = bstk::kFilePending;
+    _request->error = 0;
+    _request->data = nullptr;
+    _request->bytes_read = 0;
+    backlog.push_back(_request);
+    return true;
+}
+
+void UringFileService::Release(bstk::FileRequest* _request)
+{
+    if (_request->status == bstk::kFilePending)
+    {
+        for (auto it = backlog.begin(); it != backlog.end(); ++it)
+        {
+            if (*it == _request)
+            {
+                backlog.erase(it);
+                break;
+            }
+        }
+        for (uint32_t index = 0; index < kMaxOps; ++index)
+        {
+            UringOp& op = ops[index];
+            if (op.request != _request)
+                continue;
+
+            op.request = nullptr;
+            if (op.stage == kStageRead && _request->buffer)
+                CancelRead(index);
+        }
+    }
+    else if (!_request->buffer && _request->data)
+    {
+        ReleaseBuffer((int32_t)(((uint8_t const*)_request->data - buffer_memory) / kBufferSize));
+    }
+
+    _request->data = nullptr;
+    _request->status = bstk::kFileIdle;
+}
+
+void UringFileService::Update()
+{
+    Reap();
+
+    for (uint32_t index = 0; index < kMaxOps; ++index)
+    {
+        UringOp& op = ops[index];
+        if (op.stage != kStageWaitBuffer)
+            continue;
+
+        if (!op.request)
+        {
+            QueueClose(index);
+            continue;
+        }
+
+        if (!op.buffer)
+        {
+            if (op.size > kBufferSize)
+            {
+                Fail(index, EFBIG);
+                continue;
+            }
+            if (!AcquireBuffer(op))
+                continue;
+        }
+        QueueRead(index);
+    }
+
+    while (!backlog.empty() && StartOp(backlog.front()))
+        backlog.pop_front();
+
+    if (queued_sqes > 0)
+    {
+        __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+        int const submitted = UringEnter(ring_fd, queued_sqes, 0, 0);
+        if (submitted > 0)
+            queued_sqes -= (uint32_t)submitted;
+    }
+}
+
+std::unique_ptr<FileService> CreateUringFileService()
+{
+    std::unique_ptr<UringFileService> service{ new UringFileService() };
+    if (!service->Init())
+        return nullptr;
+    return service;
+}
@@ -0,0 +1,312 @@
+#include "tools/input_latency.hpp"
+#include "services/frame_stats.hpp"
+
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern char** environ;
+
+// Measures the time from an X input event to the LogicUpdate that first sees it: the loader
+// runs the probe module, events are synthesized through XTest one at a time after a random
+// delay so that they land anywhere in the frame loop.
+//
+// input_latency <loader> <probe module> [--events=N] [--max-delay-ms=N] [--xvfb=:N] [loader options]
+
+struct HarnessOptions
+{
+    char const* loader_path = nullptr;
+    char const* probe_path = nullptr;
+    uint32_t event_count = 500;
+    uint32_t max_delay_ms = 20;
+    // Starts a private Xvfb on that display instead of using $DISPLAY.
+    std::string xvfb_display = "";
+    std::vector<std::string> loader_args = {};
+};
+
+struct LatencyStats
+{
+    LogHistogram histogram = {};
+    uint64_t lost_count = 0;
+};
+
+static HarnessOptions ParseOptions(int argc, char const** argv)
+{
+    HarnessOptions options{};
+    uint32_t positional_index = 0;
+
+    for (int arg_index = 1; arg_index < argc; ++arg_index)
+    {
+        std::string const arg = argv[arg_index];
+        if (arg.rfind("--", 0) != 0)
+        {
+            if (positional_index == 0)
+                options.loader_path = argv[arg_index];
+            else if (positional_index == 1)
+                options.probe_path = argv[arg_index];
+            ++positional_index;
+            continue;
+        }
+
+        std::size_t const separator = arg.find('=');
+        std::string const name = arg.substr(2, separator - 2);
+        std::string const value = (separator != std::string::npos) ? arg.substr(separator + 1) : "";
+
+        if (name == "events")
+            options.event_count = (uint32_t)std::stoul(value);
+        else if (name == "max-delay-ms")
+            options.max_delay_ms = (uint32_t)std::stoul(value);
+        else if (name == "xvfb")
+            options.xvfb_display = value;
+        else
+            options.loader_args.push_back(arg);
+    }
+
+    return options;
+}
+
+static pid_t SpawnProcess(std::vector<std::string> const& _args)
+{
+    std::vector<char*> argv{};
+    for (std::string const& arg : _args)
+        argv.push_back((char*)arg.c_str());
+    argv.push_back(nullptr);
+
+    pid_t pid = -1;
+    if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+        return -1;
+    return pid;
+}
+
+static void StopProcess(pid_t _pid, std::chrono::milliseconds _grace)
+{
+    std::chrono::steady_clock::time_point const deadline = std::chrono::steady_clock::now() + _grace;
+    int status = 0;
+    while (waitpid(_pid, &status, WNOHANG) == 0)
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            kill(_pid, SIGTERM);
+            waitpid(_pid, &status, 0);
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+static Display* OpenDisplay(std::chrono::milliseconds _timeout)
+{
+    std::chrono::steady_clock::time_point const deadline = std::chrono::steady_clock::now() + _timeout;
+    for (;;)
+    {
+        if (Display* display = XOpenDisplay(nullptr))
+            return display;
+        if (std::chrono::steady_clock::now() >= deadline)
+            return nullptr;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+// False on timeout or once the loader is gone.
+static bool ReadRecord(int _fd, ProbeRecord& _record, int _timeout_ms)
+{
+    pollfd poll_fd{ _fd, POLLIN, 0 };
+    if (poll(&poll_fd, 1, _timeout_ms) <= 0)
+        return false;
+    return read(_fd, &_record, sizeof(_record)) == (ssize_t)sizeof(_record);
+}
+
+static bool WaitForRecord(int _fd, eProbeRecord _kind, int32_t _value, uint64_t& _time_ns, int _timeout_ms)
+{
+    uint64_t const deadline = ProbeNow() + (uint64_t)_timeout_ms * 1000000ull;
+    ProbeRecord record{};
+    for (uint64_t now = ProbeNow(); now < deadline; now = ProbeNow())
+    {
+        if (!ReadRecord(_fd, record, (int)((deadline - now) / 1000000ull) + 1))
+            return false;
+        if (record.kind == _kind && record.value == _value)
+        {
+            _time_ns = record.time_ns;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void PrintLatency(char const* _label, LatencyStats const& _stats)
+{
+    LogHistogram const& histogram = _stats.histogram;
+    std::cout << "\t" << _label << " over " << histogram.sample_count << " events";
+    if (histogram.sample_count > 0)
+    {
+        std::cout << " p50 " << histogram.ValueAtPercentile(50.0) << "us"
+                  << " p90 " << histogram.ValueAtPercentile(90.0) << "us"
+                  << " p99 " << histogram.ValueAtPercentile(99.0) << "us"
+                  << " max " << histogram.max_value << "us";
+    }
+    if (_stats.lost_count > 0)
+        std::cout << " (" << _stats.lost_count << " never seen)";
+    std::cout << std::endl;
+}
+
+int main(int argc, char const** argv)
+{
+    HarnessOptions const options = ParseOptions(argc, argv);
+    if (!options.loader_path || !options.probe_path)
+    {
+        std::cout << "usage: " << argv[0] << " <loader> <probe module>" << std::endl
+                  << "\t--events=N --max-delay-ms=N --xvfb=:N [loader options]" << std::endl;
+        return 1;
+    }
+
+    pid_t xvfb_pid = -1;
+    if (!options.xvfb_display.empty())
+    {
+        xvfb_pid = SpawnProcess({ "Xvfb", options.xvfb_display, "-screen", "0", "1280x1024x24", "-nolisten", "tcp" });
+        if (xvfb_pid < 0)
+        {
+            std::cout << "[ERROR] couldn't start Xvfb" << std::endl;
+            return 1;
+        }
+        setenv("DISPLAY", options.xvfb_display.c_str(), 1);
+    }
+
+    LatencyStats key_stats{};
+    LatencyStats motion_stats{};
+    bool live = false;
+
+    Display* display = OpenDisplay(std::chrono::seconds(5));
+    int event_base, error_base, major, minor;
+    int fds[2];
+    if (!display)
+    {
+        std::cout << "[ERROR] couldn't open the X display" << std::endl;
+    }
+    else if (!XTestQueryExtension(display, &event_base, &error_base, &major, &minor))
+    {
+        std::cout << "[ERROR] the X server doesn't support XTest" << std::endl;
+    }
+    else if (pipe(fds) != 0)
+    {
+        std::cout << "[ERROR] pipe failed" << std::endl;
+    }
+    else
+    {
+        // The loader inherits the write end through the probe's environment variable.
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        setenv(kProbeFdVariable, std::to_string(fds[1]).c_str(), 1);
+
+        std::vector<std::string> loader_args{ options.loader_path, options.probe_path };
+        loader_args.insert(loader_args.end(), options.loader_args.begin(), options.loader_args.end());
+        pid_t const loader_pid = SpawnProcess(loader_args);
+        close(fds[1]);
+
+        ProbeRecord ready{};
+        if (loader_pid < 0 || !ReadRecord(fds[0], ready, 10000) || ready.kind != kProbeReady)
+        {
+            std::cout << "[ERROR] the probe module didn't start" << std::endl;
+        }
+        else
+        {
+            Window const window = (Window)(uint32_t)ready.value;
+            Window child;
+            int window_x = 0, window_y = 0;
+            XTranslateCoordinates(display, window, DefaultRootWindow(display), 0, 0, &window_x, &window_y, &child);
+
+            // There's no window manager, focus follows the pointer once it is inside the window.
+            constexpr int kMargin = 16;
+            uint64_t observed_ns = 0;
+            for (int attempt = 0; attempt < 20 && !live; ++attempt)
+            {
+                XTestFakeMotionEvent(display, -1, window_x + kMargin + (attempt & 1), window_y + kMargin, CurrentTime);
+                XFlush(display);
+                live = WaitForRecord(fds[0], kProbeMotion, kMargin + (attempt & 1), observed_ns, 250);
+            }
+
+            KeyCode const probe_keycode = XKeysymToKeycode(display, XK_p);
+            std::mt19937 random{ 1u };
+            std::uniform_int_distribution<uint32_t> delay_us{ 0u, options.max_delay_ms * 1000u };
+
+            bool key_down = false;
+            uint32_t motion_index = 0;
+
+            for (uint32_t index = 0; live && index < options.event_count; ++index)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(delay_us(random)));
+
+                bool const key_event = (index & 1) == 0;
+                eProbeRecord const kind = key_event ? kProbeKeyEdge : kProbeMotion;
+                int32_t expected = 0;
+
+                uint64_t const injected_ns = ProbeNow();
+                if (key_event)
+                {
+                    key_down = !key_down;
+                    expected = key_down ? 1 : 0;
+                    XTestFakeKeyEvent(display, probe_keycode, key_down ? True : False, CurrentTime);
+                }
+                else
+                {
+                    // Alternates between two columns so that every move changes the cursor.
+                    expected = kMargin + (int32_t)(++motion_index & 1) * 8;
+                    XTestFakeMotionEvent(display, -1, window_x + expected, window_y + kMargin, CurrentTime);
+                }
+                XFlush(display);
+
+                LatencyStats& stats = key_event ? key_stats : motion_stats;
+                if (WaitForRecord(fds[0], kind, expected, observed_ns, 1000) && observed_ns >= injected_ns)
+                    stats.histogram.Record((observed_ns - injected_ns) / 1000u);
+                else
+                    ++stats.lost_count;
+            }
+
+            if (!live)
+                std::cout << "[ERROR] the probe never saw the pointer, is the window mapped?" << std::endl;
+
+            // The probe stops the loader on Escape.
+            KeyCode const escape_keycode = XKeysymToKeycode(display, XK_Escape);
+            if (key_down)
+                XTestFakeKeyEvent(display, probe_keycode, False, CurrentTime);
+            XTestFakeKeyEvent(display, escape_keycode, True, CurrentTime);
+            XTestFakeKeyEvent(display, escape_keycode, False, CurrentTime);
+            XFlush(display);
+        }
+
+        if (loader_pid >= 0)
+            StopProcess(loader_pid, std::chrono::seconds(5));
+        close(fds[0]);
+    }
+
+    if (display)
+        XCloseDisplay(display);
+    if (xvfb_pid >= 0)
+    {
+        kill(xvfb_pid, SIGTERM);
+        waitpid(xvfb_pid, nullptr, 0);
+    }
+
+    // After the loader is gone, its own reports would interleave otherwise.
+    if (!live)
+        return 1;
+
+    std::cout << "input to LogicUpdate latency, up to " << options.max_delay_ms
+              << "ms between events" << std::endl;
+    PrintLatency("key press/release", key_stats);
+    PrintLatency("pointer motion", motion_stats);
+    return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Shared by the input latency harness and its probe engine module. The probe writes a record
+// to the pipe named by kProbeFdVariable for every input change LogicUpdate observes.
+
+constexpr char const* kProbeFdVariable = "INPUT_LATENCY_FD";
+// Lower case, the way the xlib context stores ASCII keys.
+constexpr uint32_t kProbeKey = 'p';
+
+enum eProbeRecord : uint32_t
+{
+    kProbeReady = 0u,  // value is the window id
+    kProbeKeyEdge,     // value is 1 for a press, 0 for a release
+    kProbeMotion       // value is the cursor x in window coordinates
+};
+
+struct ProbeRecord
+{
+    uint32_t kind;
+    int32_t value;
+    uint64_t time_ns;
+};
+
+// Both processes use the same monotonic clock, timestamps are compared across them.
+inline uint64_t ProbeNow()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
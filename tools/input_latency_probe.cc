@@ -0,0 +1,68 @@
+#include "tools/input_latency.hpp"
+
+#include "loader/bstk.hpp"
+
+#include <unistd.h>
+
+#include <cstdlib>
+
+// Engine module for the input latency harness, timestamps input changes at the start of
+// LogicUpdate, which is when an engine can first act on them.
+struct ProbeContext
+{
+    int fd;
+    int32_t cursor_x;
+};
+
+static void WriteRecord(ProbeContext const& _context, eProbeRecord _kind, int32_t _value, uint64_t _time_ns)
+{
+    if (_context.fd < 0)
+        return;
+
+    // Below PIPE_BUF, the write is atomic.
+    ProbeRecord const record{ _kind, _value, _time_ns };
+    (void)!write(_context.fd, &record, sizeof(record));
+}
+
+extern "C" {
+
+void* ModuleInterface_Create(bstk::OSWindow const* _window)
+{
+    char const* fd_value = std::getenv(kProbeFdVariable);
+    ProbeContext* context = new ProbeContext{ fd_value ? std::atoi(fd_value) : -1, -1 };
+    WriteRecord(*context, kProbeReady, (int32_t)_window->hwindow, ProbeNow());
+    return context;
+}
+
+void ModuleInterface_Shutdown(void* _context)
+{
+    delete (ProbeContext*)_context;
+}
+
+void ModuleInterface_Reload(void*)
+{}
+
+bool ModuleInterface_LogicUpdate(void* _context, iotk::input_t const* _input)
+{
+    uint64_t const now = ProbeNow();
+    ProbeContext& context = *(ProbeContext*)_context;
+
+    if (iotk::KeyPress(kProbeKey, *_input))
+        WriteRecord(context, kProbeKeyEdge, 1, now);
+    if (iotk::KeyRelease(kProbeKey, *_input))
+        WriteRecord(context, kProbeKeyEdge, 0, now);
+
+    if (_input->cursor[0] != context.cursor_x)
+    {
+        context.cursor_x = _input->cursor[0];
+        WriteRecord(context, kProbeMotion, context.cursor_x, now);
+    }
+
+    // The harness ends the run with Escape.
+    return !iotk::KeyPress(iotk::kEscape, *_input);
+}
+
+void ModuleInterface_DrawFrame(void*, bstk::OSWindow const*)
+{}
+
+}
@@ -0,0 +1,184 @@
+#include "services/asset_pack.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#if defined(LOADER_HAS_LZ4)
+#include <lz4.h>
+#endif
+
+namespace fs = std::filesystem;
+
+struct PackInput
+{
+    std::string path;
+    std::vector<char> stored;
+    uint64_t size;
+    uint32_t flags;
+};
+
+static uint64_t AlignUp(uint64_t _value, uint64_t _alignment)
+{
+    return (_value + _alignment - 1) & ~(_alignment - 1);
+}
+
+static bool ReadInput(fs::path const& _file, std::string const& _name, bool _compress, PackInput& _input)
+{
+    std::ifstream stream(_file, std::ios::binary);
+    if (!stream)
+        return false;
+
+    std::vector<char> content{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+    _input = PackInput{ _name, {}, content.size(), 0u };
+
+#if defined(LOADER_HAS_LZ4)
+    if (_compress && !content.empty() && content.size() < (uint64_t)LZ4_MAX_INPUT_SIZE)
+    {
+        std::vector<char> compressed(LZ4_compressBound((int)content.size()));
+        int const compressed_size = LZ4_compress_default(content.data(), compressed.data(),
+                                                         (int)content.size(), (int)compressed.size());
+        // Only worth it when it saves a meaningful amount.
+        if (compressed_size > 0 && (uint64_t)compressed_size < content.size() - content.size() / 8)
+        {
+            compressed.resize(compressed_size);
+            _input.stored = std::move(compressed);
+            _input.flags |= pack::kLZ4;
+            return true;
+        }
+    }
+#else
+    (void)_compress;
+#endif
+
+    _input.stored = std::move(content);
+    return true;
+}
+
+int main(int argc, char const** argv)
+{
+    bool compress = false;
+    std::vector<char const*> positional;
+    for (int arg_index = 1; arg_index < argc; ++arg_index)
+    {
+        if (std::strcmp(argv[arg_index], "--lz4") == 0)
+            compress = true;
+        else
+            positional.push_back(argv[arg_index]);
+    }
+
+    if (positional.size() != 2)
+    {
+        std::cout << "usage: " << argv[0] << " [--lz4] <output> <directory>" << std::endl;
+        return 1;
+    }
+
+#if !defined(LOADER_HAS_LZ4)
+    if (compress)
+        std::cout << "[WARNING] packer built without LZ4, entries are stored uncompressed" << std::endl;
+#endif
+
+    fs::path const output_path = positional[0];
+    fs::path const root = positional[1];
+
+    std::vector<PackInput> inputs;
+    for (fs::directory_entry const& file : fs::recursive_directory_iterator(root))
+    {
+        if (!file.is_regular_file())
+            continue;
+        // An output inside the directory would otherwise pack the previous pack.
+        std::error_code error;
+        if (fs::equivalent(file.path(), output_path, error))
+            continue;
+
+        PackInput input;
+        std::string const name = fs::relative(file.path(), root).generic_string();
+        if (!ReadInput(file.path(), name, compress, input))
+        {
+            std::cout << "[ERROR] couldn't read " << file.path() << std::endl;
+            return 1;
+        }
+        inputs.push_back(std::move(input));
+    }
+
+    // Deterministic output regardless of directory iteration order.
+    std::sort(inputs.begin(), inputs.end(),
+              [](PackInput const& _lhs, PackInput const& _rhs) { return _lhs.path < _rhs.path; });
+
+    uint32_t const entry_count = (uint32_t)inputs.size();
+    uint32_t const bucket_count = pack::BucketCount(entry_count);
+
+    pack::Header header{};
+    std::memcpy(header.magic, pack::kMagic, sizeof(pack::kMagic));
+    header.version = pack::kVersion;
+    header.entry_count = entry_count;
+    header.bucket_count = bucket_count;
+    header.entries_offset = AlignUp(sizeof(pack::Header), alignof(pack::Entry));
+    header.buckets_offset = header.entries_offset + entry_count * sizeof(pack::Entry);
+    header.strings_offset = header.buckets_offset + bucket_count * sizeof(uint32_t);
+
+    std::vector<pack::Entry> entries(entry_count);
+    std::vector<uint32_t> buckets(bucket_count, pack::kEmptyBucket);
+    std::string strings;
+
+    for (uint32_t index = 0; index < entry_count; ++index)
+    {
+        PackInput const& input = inputs[index];
+        pack::Entry& entry = entries[index];
+        entry.path_hash = pack::HashPath(input.path);
+        entry.size = input.size;
+        entry.stored_size = input.stored.size();
+        entry.path_offset = (uint32_t)strings.size();
+        entry.path_length = (uint32_t)input.path.size();
+        entry.flags = input.flags;
+        strings += input.path;
+
+        uint32_t const mask = bucket_count - 1;
+        uint32_t slot = (uint32_t)entry.path_hash & mask;
+        while (buckets[slot] != pack::kEmptyBucket)
+            slot = (slot + 1) & mask;
+        buckets[slot] = index;
+    }
+
+    uint64_t offset = AlignUp(header.strings_offset + strings.size(), pack::kAlignment);
+    for (uint32_t index = 0; index < entry_count; ++index)
+    {
+        entries[index].offset = offset;
+        offset = AlignUp(offset + entries[index].stored_size, pack::kAlignment);
+    }
+    header.file_size = offset;
+
+    std::ofstream output(output_path, std::ios::binary | std::ios::trunc);
+    if (!output)
+    {
+        std::cout << "[ERROR] couldn't open " << output_path << std::endl;
+        return 1;
+    }
+
+    auto pad_to = [&output](uint64_t _offset) {
+        static char const zeros[pack::kAlignment] = {};
+        uint64_t const position = (uint64_t)output.tellp();
+        if (_offset > position)
+            output.write(zeros, (std::streamsize)(_offset - position));
+    };
+
+    output.write((char const*)&header, sizeof(header));
+    pad_to(header.entries_offset);
+    output.write((char const*)entries.data(), (std::streamsize)(entries.size() * sizeof(pack::Entry)));
+    output.write((char const*)buckets.data(), (std::streamsize)(buckets.size() * sizeof(uint32_t)));
+    output.write(strings.data(), (std::streamsize)strings.size());
+
+    for (uint32_t index = 0; index < entry_count; ++index)
+    {
+        pad_to(entries[index].offset);
+        output.write(inputs[index].stored.data(), (std::streamsize)inputs[index].stored.size());
+    }
+    pad_to(header.file_size);
+
+    std::cout << "packed " << entry_count << " files into " << output_path
+              << " (" << header.file_size << " bytes)" << std::endl;
+    return output ? 0 : 1;
+}